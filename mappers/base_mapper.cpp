@@ -2,10 +2,21 @@
 
 Mapper::Mapper(uint8_t _num_prg_banks, uint8_t _num_chr_banks) :
     num_prg_banks(_num_prg_banks),
-    num_chr_banks(_num_chr_banks) {
+    num_chr_banks(_num_chr_banks),
+    bank_serial(0) {
 
 }
 
 Mapper::~Mapper() {
 
 }
+
+uint32_t Mapper::get_bank_serial() { return bank_serial; }
+
+bool Mapper::get_mirror(uint8_t &mirror) { (void) mirror; return false; }
+
+void Mapper::save_state(State &state) { for (auto &reg : state.regs) reg = 0x00; }
+
+void Mapper::load_state(const State &state) { (void) state; }
+
+void Mapper::invalidate_mapping() { bank_serial++; }
@@ -12,6 +12,31 @@ protected:
     uint8_t num_prg_banks;
     uint8_t num_chr_banks;
 
+    // Mappers bump this on every bank switch or mirroring change so that
+    // anything caching the address mapping (e.g. the CPU page table of 'Bus'
+    // or the PPU nametable pointers) refreshes it
+    uint32_t bank_serial;
+
+public:
+    uint32_t get_bank_serial();
+
+    // Nametable mirroring of mappers that switch it at runtime, as a
+    // 'Cartridge::MIRROR' value. False if the cartridge hardwires it
+    virtual bool get_mirror(uint8_t &mirror);
+
+    // Snapshots of the mapper registers, sized for any mapper. Mappers with
+    // registers store them in 'regs' and bump 'bank_serial' on loading a
+    // different mapping
+    struct State {
+        uint8_t regs[16];
+    };
+
+    virtual void save_state(State &state);
+    virtual void load_state(const State &state);
+
+    // Cartridge memory behind the current mapping changed as a whole
+    void invalidate_mapping();
+
 public:
     // Transform CPU bus address into PRG ROM offset
     virtual bool get_cpu_read_mapped_addr(uint16_t addr, uint16_t &mapped_addr) = 0;
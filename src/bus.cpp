@@ -1,9 +1,23 @@
+#include <algorithm>
 #include "bus.h"
 
-Bus::Bus() : cpu(nullptr), ppu(nullptr), clock_cycles(0) {
+// Number of CPU clock ticks (every third bus tick) before bus tick 'tick'
+#define CPU_TICKS_BEFORE(tick) (((tick) + 2) / 3)
+
+// Longest backward jump considered for idle loop detection
+#define IDLE_LOOP_MAX_BYTES 32
+
+Bus::Bus() :
+    cpu(nullptr), ppu(nullptr), clock_cycles(0), mapper_bank_serial(0), ppu_cycles(0),
+    io_access(false), side_effects(0), status_reads(0), last_status(0), idle_cycles(0)
+{
+    idle_loop.valid = false;
     for (auto &byte : cpu_ram) byte = 0x00;
+    map_cpu_pages();
 
     // Reset controller states
+    controller[0] = 0x00;
+    controller[1] = 0x00;
     controller_states[0] = 0x00;
     controller_states[1] = 0x00;
 }
@@ -18,11 +32,63 @@ void Bus::connect_to_cartridge(const std::shared_ptr<Cartridge>& _cartridge) {
     cartridge = _cartridge;
     assert(ppu);
     ppu->connect_to_cartridge(_cartridge);
+    assert(cpu);
+    cpu->reset_decoded_cache(_cartridge->get_prg_size());
+    map_cpu_pages();
 }
 
-void Bus::write(uint16_t addr, uint8_t data) {
+/* Rebuilds the CPU page tables from RAM mirrors and the cartridge mapping */
+void Bus::map_cpu_pages() {
+    for (uint16_t page = 0; page < 256; page++) {
+        uint16_t addr = page << 8;
+
+        // The 2kB actual memory is mirrored to represent 8kB range
+        if (addr >= SYSTEM_RAM_ADDR_LOWER && addr <= SYSTEM_RAM_ADDR_UPPER) {
+            read_pages[page] = write_pages[page] = &cpu_ram[addr & 0x07FF];
+            prg_pages[page] = -1;
+        }
+
+        // PPU, APU and IO registers, including the start of the cartridge
+        // space sharing their page ($4020-$40FF)
+        else if (addr < CARTRIDGE_PAGES_LOWER || !cartridge) {
+            read_pages[page] = write_pages[page] = nullptr;
+            prg_pages[page] = -1;
+        }
+
+        // Cartridge writes stay on the slow path so that code written to PRG
+        // memory drops out of the CPU decoded instruction cache
+        else {
+            prg_pages[page] = cartridge->get_prg_page_offset(page);
+            read_pages[page] = (prg_pages[page] < 0) ? nullptr :
+                               cartridge->get_prg_memory() + prg_pages[page];
+            write_pages[page] = nullptr;
+        }
+    }
+
+    if (cartridge) mapper_bank_serial = cartridge->get_bank_serial();
+}
+
+void Bus::write_io(uint16_t addr, uint8_t data) {
+    io_access = true;
+
+    // A write to cartridge space may switch banks or mirroring, so the PPU
+    // runs up to the write with the old mapping first
+    if (ppu && addr >= CARTRIDGE_ADDR_LOWER) sync_ppu(clock_cycles + 1);
+    if (cartridge_hook && addr >= CARTRIDGE_ADDR_LOWER) cartridge_hook(addr, data);
     cartridge->handle_cpu_write(addr, data);
 
+    // Mapper switched banks or mirroring, page table and nametables are stale
+    if (cartridge->get_bank_serial() != mapper_bank_serial) {
+        map_cpu_pages();
+        if (ppu) ppu->map_nametables();
+    }
+
+    // Self-modifying ROM code, decoded instructions are stale
+    if (addr >= CARTRIDGE_ADDR_LOWER) {
+        int32_t offset = cartridge->get_prg_offset(addr, true);
+        if (offset >= 0) cpu->invalidate_decoded(offset);
+    }
+
     // Write to main bus RAM
     // The 2kB actual memory is mirrored to represent 8kB range
     if (addr >= SYSTEM_RAM_ADDR_LOWER && addr <= SYSTEM_RAM_ADDR_UPPER) {
@@ -32,6 +98,7 @@ void Bus::write(uint16_t addr, uint8_t data) {
     // Write to PPU address range
     else if (addr >= SYSTEM_PPU_ADDR_LOWER && addr <= SYSTEM_PPU_ADDR_UPPER) {
         assert(ppu);
+        sync_ppu(clock_cycles + 1);
         ppu->write_to_main_bus(addr & 0x0007, data);
     }
 
@@ -44,11 +111,13 @@ void Bus::write(uint16_t addr, uint8_t data) {
 
     // Write to controller address range
     else if (addr >= CONTROLLER_ADDR_LOWER && addr <= CONTROLLER_ADDR_UPPER) {
+        if (input_hook) input_hook();
         controller_states[addr & 0x0001] = controller[addr & 0x0001];
     }
 }
 
-uint8_t Bus::read(uint16_t addr, bool read_only) {
+uint8_t Bus::read_io(uint16_t addr, bool read_only) {
+    io_access = true;
     uint8_t data = cartridge->handle_cpu_read(addr);
 
     // Read from main bus RAM
@@ -60,11 +129,15 @@ uint8_t Bus::read(uint16_t addr, bool read_only) {
     // Read from PPU address range
     else if (addr >= SYSTEM_PPU_ADDR_LOWER && addr <= SYSTEM_PPU_ADDR_UPPER) {
         assert(ppu);
+        sync_ppu(clock_cycles + 1);
         data = ppu->read_from_main_bus(addr & 0x0007, read_only);
+        if ((addr & 0x0007) == 0x0002) { status_reads++; last_status = data; }
+        else side_effects++;
     }
 
     // Read from controller address range
     else if (addr >= CONTROLLER_ADDR_LOWER && addr <= CONTROLLER_ADDR_UPPER) {
+        side_effects++;
         data = (controller_states[addr & 0x0001] & 0x80) > 0;
         controller_states[addr & 0x0001] <<= 1;
     }
@@ -74,6 +147,7 @@ uint8_t Bus::read(uint16_t addr, bool read_only) {
 void Bus::clock() {
     assert(ppu); ppu->clock();
     assert(cpu);
+    ppu_cycles++;
 
     if (clock_cycles % 3 == 0) {
         // Stops bus clock to handle DMA transfer to OAM memory
@@ -86,7 +160,7 @@ void Bus::clock() {
                     dma_data = read(dma_page << 8 | dma_addr, false);
                 }
                 else {
-                    ppu->oam_ptr[dma_addr] = dma_data;
+                    ppu->write_oam(dma_addr, dma_data);
                     dma_addr++;
 
                     // DMA is done when 256 bytes have been written or when
@@ -105,14 +179,238 @@ void Bus::clock() {
         }
     }
 
-    if (ppu->nmi()) { cpu->nmi(); ppu->reset_nmi(); }
+    check_nmi();
     clock_cycles++;
 }
 
+/* Hands a pending PPU NMI over to the CPU */
+void Bus::check_nmi() {
+    if (ppu->nmi()) {
+        cpu->nmi();
+        ppu->reset_nmi();
+        side_effects++;
+    }
+}
+
+/* Clocks the PPU until it has run all bus ticks before 'until' */
+void Bus::sync_ppu(uint64_t until) {
+    assert(ppu);
+    if (ppu_cycles >= until) return;
+    ppu->clock(until - ppu_cycles);
+    ppu_cycles = until;
+}
+
+/* Emulates until the PPU completes a frame. Gives the same result as calling
+ * 'clock()' until then, but the CPU executes whole instructions at once and the
+ * PPU only catches up when its registers are accessed, when NMI fires or when
+ * the frame ends */
+void Bus::clock_frame() {
+    assert(cpu);
+    assert(ppu);
+
+    while (true) {
+        // OAM DMA interleaves with the PPU, step it one tick at a time
+        if (dma_transfer) {
+            sync_ppu(clock_cycles);
+            clock();
+            if (ppu->frame_completed()) return;
+            continue;
+        }
+
+        // Upcoming bus ticks where the PPU completes the frame and raises NMI
+        uint64_t frame_end = ppu_cycles + ppu->dots_until(260, 340);
+        uint64_t vblank = ppu->nmi_enabled() ?
+                          ppu_cycles + ppu->dots_until(241, 1) : UINT64_MAX;
+        uint64_t event = std::min(frame_end, vblank);
+
+        // Bus tick at which the CPU starts its next instruction
+        uint64_t next_instr = CPU_TICKS_BEFORE(clock_cycles) * 3
+                              + 3 * cpu->get_remaining_cycles();
+
+        // The event comes first: only the PPU has work to do until then
+        if (event < next_instr) {
+            cpu->skip_cycles(CPU_TICKS_BEFORE(event + 1) - CPU_TICKS_BEFORE(clock_cycles));
+            sync_ppu(event + 1);
+            clock_cycles = event + 1;
+
+            check_nmi();
+            if (ppu->frame_completed()) return;
+            continue;
+        }
+
+        // Idle loop, jump ahead by whole iterations
+        if (skip_idle_loop(next_instr, event)) continue;
+
+        // Block backend, run the basic block while the event is ahead
+        uint8_t num_instrs = 0;
+        if (cpu->get_backend() == cpu6502::BLOCKS && next_instr < event &&
+            (num_instrs = cpu->build_block()) > 0) {
+            run_block(num_instrs, event);
+        }
+
+        // Run the whole instruction at its first clock tick
+        else {
+            cpu->skip_cycles(cpu->get_remaining_cycles());
+            clock_cycles = next_instr;
+            if (instr_hook) instr_hook();
+            cpu->clock(CPU_TICKS_BEFORE(event) - CPU_TICKS_BEFORE(next_instr));
+
+            if (event == next_instr) sync_ppu(next_instr + 1);
+            clock_cycles = next_instr + 1;
+        }
+
+        check_nmi();
+        if (ppu->frame_completed()) return;
+    }
+}
+
+/* Runs up to 'num_instrs' instructions of the block 'build_block()' just
+ * returned, each at its first clock tick, as long as they start before
+ * 'event'. Leaves the block after any access that is not to RAM or PRG memory,
+ * since it may move the next event, start OAM DMA or modify the block */
+void Bus::run_block(uint8_t num_instrs, uint64_t event) {
+    io_access = false;
+
+    // Fused pairs run two instructions at once
+    uint16_t idx = 0;
+    while (idx < num_instrs && !io_access) {
+        uint64_t next_instr = CPU_TICKS_BEFORE(clock_cycles) * 3
+                              + 3 * cpu->get_remaining_cycles();
+        if (next_instr >= event) return;
+
+        cpu->skip_cycles(cpu->get_remaining_cycles());
+        clock_cycles = next_instr;
+        if (instr_hook) instr_hook();
+        idx += cpu->run_block_instr(idx, CPU_TICKS_BEFORE(event) - CPU_TICKS_BEFORE(next_instr));
+        clock_cycles = next_instr + 1;
+    }
+}
+
+/* Called at the start of the instruction at bus tick 'next_instr', with the
+ * next event not before it. Skips as many iterations of an idle loop as fit
+ * before 'event' or, for loops polling the PPU status register, before the
+ * status can change. Returns whether any were skipped */
+bool Bus::skip_idle_loop(uint64_t next_instr, uint64_t event) {
+    uint16_t instr_pc = cpu->get_instr_pc();
+    if (cpu->pc >= instr_pc || instr_pc - cpu->pc > IDLE_LOOP_MAX_BYTES) return false;
+
+    // Already fast-forwarded to this instruction
+    if (idle_loop.valid && idle_loop.tick == next_instr) return false;
+
+    cpu->flush_flags();
+    IdleLoop loop = { true, cpu->pc, cpu->a, cpu->x, cpu->y, cpu->stkp, cpu->status,
+                      next_instr, cpu->get_instr_count(), side_effects, status_reads };
+
+    bool repeated = idle_loop.valid && loop.pc == idle_loop.pc &&
+                    loop.a == idle_loop.a && loop.x == idle_loop.x &&
+                    loop.y == idle_loop.y && loop.stkp == idle_loop.stkp &&
+                    loop.status == idle_loop.status &&
+                    loop.side_effects == idle_loop.side_effects;
+    bool polls_status = loop.status_reads != idle_loop.status_reads;
+    uint64_t period = loop.tick - idle_loop.tick;
+    uint64_t instrs = loop.instrs - idle_loop.instrs;
+
+    idle_loop = loop;
+    if (!repeated) return false;
+
+    // Polling the PPU status register, it has to read the same as last time
+    uint64_t horizon = event;
+    if (polls_status) {
+        sync_ppu(next_instr);
+        if (ppu->peek_status() != last_status) return false;
+        horizon = std::min(horizon, ppu_cycles + ppu->dots_until_status_change());
+    }
+
+    uint64_t iterations = (horizon - next_instr) / period;
+    if (iterations == 0) return false;
+
+    cpu->skip_cycles(cpu->get_remaining_cycles());
+    cpu->skip_instrs(iterations * instrs, iterations * period / 3);
+    clock_cycles = next_instr + iterations * period;
+    idle_cycles += iterations * period / 3;
+
+    idle_loop.tick = clock_cycles;
+    idle_loop.instrs = cpu->get_instr_count();
+    return true;
+}
+
+uint64_t Bus::get_idle_cycles() { return idle_cycles; }
+
+/* Clocks the bus tick by tick until the CPU is about to start instruction
+ * number 'instr', which is the state 'instr_hook' sees in 'clock_frame()' */
+void Bus::clock_to_instr(uint64_t instr) {
+    while (clock_cycles % 3 != 0 || !cpu->instr_completed() || dma_transfer ||
+           cpu->get_instr_count() < instr) clock();
+}
+
+/* Saves the machine into 'state', with the PPU caught up to the bus first */
+void Bus::save_state(State &state) {
+    assert(cpu);
+    assert(ppu);
+    sync_ppu(clock_cycles);
+
+    cpu->save_state(state.cpu);
+    ppu->save_state(state.ppu);
+    cartridge->save_state(state.cartridge);
+
+    std::copy(cpu_ram, cpu_ram + _2_KB, state.cpu_ram);
+    std::copy(controller, controller + 2, state.controller);
+    std::copy(controller_states, controller_states + 2, state.controller_states);
+    state.clock_cycles = clock_cycles;
+
+    state.dma_page = dma_page;
+    state.dma_addr = dma_addr;
+    state.dma_data = dma_data;
+    state.dma_idle = dma_idle;
+    state.dma_transfer = dma_transfer;
+}
+
+/* Restores the machine saved in 'state'. Decoded instructions from PRG memory
+ * that differs in 'state' are dropped, idle loop detection starts over */
+void Bus::load_state(const State &state) {
+    assert(cpu);
+    assert(ppu);
+
+    const uint8_t *prg = cartridge->get_prg_memory();
+    const uint8_t *saved_prg = state.cartridge.prg_memory.data();
+    size_t prg_size = cartridge->get_prg_size();
+    for (size_t page = 0; page < prg_size; page += 0x0100) {
+        size_t page_end = std::min<size_t>(page + 0x0100, prg_size);
+        if (std::equal(prg + page, prg + page_end, saved_prg + page)) continue;
+        for (size_t offset = page; offset < page_end; offset++) {
+            if (prg[offset] != saved_prg[offset]) cpu->invalidate_decoded(offset);
+        }
+    }
+
+    cartridge->load_state(state.cartridge);
+    cpu->load_state(state.cpu);
+    ppu->load_state(state.ppu);
+
+    std::copy(state.cpu_ram, state.cpu_ram + _2_KB, cpu_ram);
+    std::copy(state.controller, state.controller + 2, controller);
+    std::copy(state.controller_states, state.controller_states + 2, controller_states);
+    clock_cycles = state.clock_cycles;
+    ppu_cycles = state.clock_cycles;
+
+    dma_page = state.dma_page;
+    dma_addr = state.dma_addr;
+    dma_data = state.dma_data;
+    dma_idle = state.dma_idle;
+    dma_transfer = state.dma_transfer;
+
+    idle_loop.valid = false;
+    map_cpu_pages();
+}
+
+/* Number of bus clock ticks (PPU dots) since last reset */
+uint64_t Bus::get_clock_cycles() { return clock_cycles; }
+
 void Bus::reset() {
     assert(cpu != nullptr); cpu->reset();
     assert(ppu != nullptr); ppu->reset();
     clock_cycles = 0;
+    ppu_cycles = 0;
+    idle_loop.valid = false;
 
     // Reset OAM DMA
     dma_page = 0x00;
@@ -1,6 +1,7 @@
 #ifndef BUS_H_
 #define BUS_H_
 
+#include <functional>
 #include "mem.h"
 #include "cpu.h"
 #include "ppu.h"
@@ -23,19 +24,106 @@ public:
 
 public:
     void clock();
+    void clock_frame();
     void reset();
 
-    void write(uint16_t addr, uint8_t data);
-    uint8_t read(uint16_t addr, bool read_only = false);
+    inline void write(uint16_t addr, uint8_t data);
+    inline uint8_t read(uint16_t addr, bool read_only = false);
+
+    // PRG memory offset of a CPU address, -1 if it is not ROM-resident
+    inline int32_t get_prg_offset(uint16_t addr);
+
+    uint64_t get_clock_cycles();
+
+    // Differential testing - 'instr_hook' is called right before every
+    // instruction 'clock_frame()' runs, 'clock_to_instr()' is the tick by
+    // tick counterpart
+    std::function<void()> instr_hook;
+    void clock_to_instr(uint64_t instr);
+
+    // Called on writes to cartridge space right before the mapper gets them,
+    // with the PPU caught up to the write
+    std::function<void(uint16_t addr, uint8_t data)> cartridge_hook;
+
+    // Called on controller port writes right before 'controller' is latched,
+    // so that the host input can be sampled the moment the game asks for it
+    std::function<void()> input_hook;
+
+    // CPU clock cycles skipped by fast-forwarding idle loops
+    uint64_t get_idle_cycles();
+
+    // Snapshots of the whole machine. Saving and loading copy into storage the
+    // state already has, only the first 'save_state()' into it allocates
+    struct State {
+        cpu6502::State cpu;
+        ppu2C02::State ppu;
+        Cartridge::State cartridge;
+
+        uint8_t cpu_ram[_2_KB];
+        uint8_t controller[2];
+        uint8_t controller_states[2];
+        uint64_t clock_cycles;
+
+        uint8_t dma_page, dma_addr, dma_data;
+        bool dma_idle, dma_transfer;
+    };
+
+    void save_state(State &state);
+    void load_state(const State &state);
 
 public:
     uint8_t cpu_ram[_2_KB];
     uint8_t controller[2];
 
 private:
-    uint32_t clock_cycles;
+    uint64_t clock_cycles;
     uint8_t controller_states[2];
 
+// CPU memory map - direct pointers into RAM or PRG memory for each 256 byte
+// page. Pages without one (PPU and APU / IO registers, cartridge writes,
+// unmapped cartridge space) go through the slower 'read_io' and 'write_io'
+// handlers
+private:
+    uint8_t *read_pages[256];
+    uint8_t *write_pages[256];
+    int32_t prg_pages[256];             // PRG offset of each page or -1
+    uint32_t mapper_bank_serial;
+
+    void map_cpu_pages();
+    void write_io(uint16_t addr, uint8_t data);
+    uint8_t read_io(uint16_t addr, bool read_only);
+
+// Instruction granular scheduling - the PPU lags behind and is caught up on
+// demand (PPU register access, NMI, end of frame)
+private:
+    uint64_t ppu_cycles;        // Bus clock ticks the PPU has actually run
+    bool io_access;             // Set by any access that is not to RAM or PRG
+    void sync_ppu(uint64_t until);
+    void check_nmi();
+    void run_block(uint8_t num_instrs, uint64_t event);
+
+// Idle loop fast-forward - when a short backward jump brings the CPU back to
+// the state it had one iteration ago, without writes, NMI or reads with side
+// effects in between, the loop keeps repeating until something outside the
+// CPU changes. Whole iterations up to that point are skipped
+private:
+    struct IdleLoop {
+        bool valid;
+        uint16_t pc;
+        uint8_t a, x, y, stkp, status;
+        uint64_t tick;          // Bus tick the iteration started at
+        uint64_t instrs;        // CPU instruction count at that point
+        uint32_t side_effects;
+        uint32_t status_reads;
+    } idle_loop;
+
+    uint32_t side_effects;      // Writes, NMIs and IO reads other than $2002
+    uint32_t status_reads;      // PPU status register reads
+    uint8_t last_status;        // Value of the last one
+    uint64_t idle_cycles;
+
+    bool skip_idle_loop(uint64_t next_instr, uint64_t event);
+
 // OAM DMA
 private:
     uint8_t dma_page = 0x00;
@@ -46,4 +134,23 @@ private:
     bool dma_transfer = false;  // Indicates whether DMA transfer is happening
 };
 
+/* CPU memory map fast path, RAM and PRG accesses are a single indexed load */
+void Bus::write(uint16_t addr, uint8_t data) {
+    side_effects++;
+    uint8_t *page = write_pages[addr >> 8];
+    if (page) page[addr & 0x00FF] = data;
+    else write_io(addr, data);
+}
+
+uint8_t Bus::read(uint16_t addr, bool read_only) {
+    const uint8_t *page = read_pages[addr >> 8];
+    if (page) return page[addr & 0x00FF];
+    return read_io(addr, read_only);
+}
+
+int32_t Bus::get_prg_offset(uint16_t addr) {
+    int32_t page = prg_pages[addr >> 8];
+    return (page < 0) ? -1 : page + (addr & 0x00FF);
+}
+
 #endif
@@ -1,9 +1,10 @@
 #include <iostream>
+#include <algorithm>
 #include "mem.h"
 #include "cartridge.h"
 
 Cartridge::Cartridge(const char *nes_file_name) :
-    mapper_id(0), num_prg_banks(0), num_chr_banks(0)
+    mapper_id(0), num_prg_banks(0), num_chr_banks(0), rom_checksum(0)
 {
     struct __attribute__((__packed__)) {
         char name[4];
@@ -28,6 +29,7 @@ Cartridge::Cartridge(const char *nes_file_name) :
             ifs.seekg(_HALF_KB, std::ios_base::cur);
 
         mirror = (header.mapper_1 & 0x01) ? VERTICAL : HORIZONTAL;
+        if (header.mapper_1 & 0x08) mirror = FOUR_SCREEN;
 
         // Hard coded for now
         uint8_t file_format_type = 1;
@@ -43,6 +45,13 @@ Cartridge::Cartridge(const char *nes_file_name) :
                 chr_memory_rom.resize(num_chr_banks * _8_KB);
                 ifs.read((char *)chr_memory_rom.data(), chr_memory_rom.size());
 
+                prg_image = prg_memory_rom;
+                chr_image = chr_memory_rom;
+
+                // FNV-1a over both images
+                rom_checksum = 2166136261u;
+                for (uint8_t byte : prg_image) rom_checksum = (rom_checksum ^ byte) * 16777619u;
+                for (uint8_t byte : chr_image) rom_checksum = (rom_checksum ^ byte) * 16777619u;
                 break;
             }
             case 2: break;
@@ -85,6 +94,39 @@ void Cartridge::handle_cpu_write(uint16_t addr, uint8_t data) {
     }
 }
 
+/* Offset into PRG memory CPU address 'addr' maps to, or -1 if unmapped */
+int32_t Cartridge::get_prg_offset(uint16_t addr, bool write) {
+    uint16_t mapped_addr = 0;
+    bool mapped = write ?
+        mapper_ptr->get_cpu_write_mapped_addr(addr, mapped_addr) :
+        mapper_ptr->get_cpu_read_mapped_addr(addr, mapped_addr);
+
+    if (!mapped || mapped_addr >= prg_memory_rom.size()) return -1;
+    return mapped_addr;
+}
+
+/* Offset into PRG memory a whole CPU page is read from, or -1 if the mapper
+ * does not map the page linearly into PRG memory */
+int32_t Cartridge::get_prg_page_offset(uint8_t page) {
+    int32_t first = get_prg_offset(page << 8, false);
+    int32_t last = get_prg_offset((page << 8) | 0x00FF, false);
+
+    if (first < 0 || last != first + 0x00FF) return -1;
+    return first;
+}
+
+uint8_t *Cartridge::get_prg_memory() { return prg_memory_rom.data(); }
+
+size_t Cartridge::get_prg_size() { return prg_memory_rom.size(); }
+
+uint32_t Cartridge::get_bank_serial() { return mapper_ptr->get_bank_serial(); }
+
+/* Current nametable mirroring, from the mapper if it switches it at runtime */
+Cartridge::MIRROR Cartridge::get_mirror() {
+    uint8_t mapper_mirror = 0;
+    return mapper_ptr->get_mirror(mapper_mirror) ? (MIRROR)mapper_mirror : mirror;
+}
+
 uint8_t Cartridge::handle_ppu_read(uint16_t addr) {
     uint16_t mapped_addr = 0;
     if (mapper_ptr->get_ppu_read_mapped_addr(addr, mapped_addr)) {
@@ -99,3 +141,29 @@ void Cartridge::handle_ppu_write(uint16_t addr, uint8_t data) {
         chr_memory_rom[mapped_addr] = data;
     }
 }
+
+void Cartridge::save_state(State &state) {
+    state.prg_memory = prg_memory_rom;
+    state.chr_memory = chr_memory_rom;
+    mapper_ptr->save_state(state.mapper);
+}
+
+/* Inverse of 'save_state()'. Anything caching CHR memory through the mapping
+ * (e.g. the PPU tile cache) is invalidated if it differs */
+void Cartridge::load_state(const State &state) {
+    assert(state.prg_memory.size() == prg_memory_rom.size());
+    assert(state.chr_memory.size() == chr_memory_rom.size());
+    bool chr_changed = state.chr_memory != chr_memory_rom;
+
+    // Copied in place, the bus page table points into PRG memory
+    std::copy(state.prg_memory.begin(), state.prg_memory.end(), prg_memory_rom.begin());
+    std::copy(state.chr_memory.begin(), state.chr_memory.end(), chr_memory_rom.begin());
+    mapper_ptr->load_state(state.mapper);
+    if (chr_changed) mapper_ptr->invalidate_mapping();
+}
+
+const std::vector<uint8_t> &Cartridge::get_prg_image() { return prg_image; }
+
+const std::vector<uint8_t> &Cartridge::get_chr_image() { return chr_image; }
+
+uint32_t Cartridge::get_rom_checksum() { return rom_checksum; }
@@ -2,7 +2,9 @@
 #define CARTRIDGE_H_
 
 #include <vector>
+#include <memory>
 #include <fstream>
+#include <cassert>
 #include "mapper_0.h"
 
 class Cartridge {
@@ -10,7 +12,7 @@ public:
     Cartridge(const char *nes_file_name);
     ~Cartridge();
 
-    enum MIRROR { HORIZONTAL, VERTICAL, ONESCREEN_LO, ONESCREEN_HI } mirror;
+    enum MIRROR { HORIZONTAL, VERTICAL, ONESCREEN_LO, ONESCREEN_HI, FOUR_SCREEN } mirror;
 
 private:
     uint8_t mapper_id;
@@ -21,14 +23,43 @@ private:
     std::vector<uint8_t> prg_memory_rom;
     std::vector<uint8_t> chr_memory_rom;
 
+    // PRG and CHR memory as loaded from the file
+    std::vector<uint8_t> prg_image;
+    std::vector<uint8_t> chr_image;
+    uint32_t rom_checksum;
+
 public:
     // Main bus communication
     uint8_t handle_cpu_read(uint16_t addr);
     void handle_cpu_write(uint16_t addr, uint8_t data);
 
+    // Direct access to the PRG memory behind CPU addresses
+    int32_t get_prg_offset(uint16_t addr, bool write);
+    int32_t get_prg_page_offset(uint8_t page);
+    uint8_t *get_prg_memory();
+    size_t get_prg_size();
+    uint32_t get_bank_serial();
+    MIRROR get_mirror();
+
     // PPU bus communication
     uint8_t handle_ppu_read(uint16_t addr);
     void handle_ppu_write(uint16_t addr, uint8_t data);
+
+    // Snapshots - cartridge memory and mapper registers. The vectors are sized
+    // by the first 'save_state()', later ones reuse them
+    struct State {
+        std::vector<uint8_t> prg_memory;
+        std::vector<uint8_t> chr_memory;
+        Mapper::State mapper;
+    };
+
+    void save_state(State &state);
+    void load_state(const State &state);
+
+    // Contents of the ROM file, save states only store what differs from it
+    const std::vector<uint8_t> &get_prg_image();
+    const std::vector<uint8_t> &get_chr_image();
+    uint32_t get_rom_checksum();
 };
 
 #endif
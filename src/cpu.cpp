@@ -1,11 +1,22 @@
+#include <cstring>
+#include <algorithm>
 #include "mem.h"
 #include "bus.h"
 #include "cpu.h"
+#include "instructions.h"
+
+// Instructions kept in built blocks before all blocks are built anew
+#define MAX_BLOCK_CODE 0x10000
 
 cpu6502::cpu6502() :
     bus(nullptr), a(0x00), x(0x00), y(0x00), stkp(0x00), pc(0x0000), status(0x00),
-    _fetched(0), _temp(0), _addr_abs(0), _addr_rel(0), _opcode(0), _remaining_cycles(0),
-    _clock_count(0) {}
+    _fetched(0), _temp(0), _addr_abs(0), _addr_rel(0), _opcode(0), _instr_pc(0), _operand(0),
+    _next_operand(0),
+    _implied(false), _decoded(false),
+    _remaining_cycles(0),
+    _clock_count(0), _instr_count(0),
+    _flag_n(0), _flag_z(1), _flag_c(0), _flag_v(0), _fused_counts(NUM_FUSED_PAIRS, 0),
+    _backend(INTERPRETER), _block(0) {}
 
 cpu6502::~cpu6502() {}
 
@@ -27,41 +38,95 @@ void cpu6502::write_to_bus(uint16_t addr, uint8_t data) {
 /*=============================================================================
  * 6502 CPU INTERNAL STATE METHODS
  *===========================================================================*/
-// Flags getters
+// Flags getters (I, D, B and U only, N Z C V are lazy)
 uint8_t cpu6502::get_flag(flags f) {
+    assert(!(f & (N | Z | C | V)));
     return ((status & f) > 0) ? 0x01 : 0x00;
 }
 
-// Flags setters
+// Flags setters (I, D, B and U only, N Z C V are lazy)
 void cpu6502::set_flag(flags f, bool v) {
+    assert(!(f & (N | Z | C | V)));
     if (v) status |= f; else status &= ~f;
 }
 
-/* Emulates one CPU clock cycle */
-void cpu6502::clock() {
+// Lazy N and Z flags from an instruction result
+void cpu6502::set_nz(uint8_t result) {
+    _flag_n = result;
+    _flag_z = result;
+}
+
+/* Folds the lazy N, Z, C and V flags into 'status' */
+void cpu6502::flush_flags() {
+    status = (status & ~(N | Z | C | V)) |
+             (_flag_n & N) |
+             (_flag_z ? 0x00 : Z) |
+             (_flag_c & C) |
+             ((_flag_v & 0x80) >> 1);
+}
+
+/* Inverse of 'flush_flags()', after 'status' was overwritten as a whole */
+void cpu6502::load_flags() {
+    _flag_n = status;
+    _flag_z = ~status & Z;
+    _flag_c = status & C;
+    _flag_v = status << 1;
+}
+
+/* Emulates one CPU clock cycle. A decoded instruction that starts a fused pair
+ * runs together with the next one if that starts less than 'fusion_window'
+ * clock cycles from now, i.e. nothing else on the bus can happen in between */
+void cpu6502::clock(uint32_t fusion_window) {
     if (_remaining_cycles == 0) {
-        // Get opcode for next instruction
-        _opcode = read_from_bus(pc);
+        const DecodedInstr *instr = decoded_instr(pc);
+        _instr_pc = pc;
 
-        // Increment program counter
-        pc++;
-        _remaining_cycles = instructions_table[_opcode].cycles;
+        // ROM-resident instruction, opcode and operand come from the cache
+        if (instr) {
+            execute_decoded(*instr, fusion_window);
+        }
+
+        else {
+            // Get opcode for next instruction
+            _opcode = read_from_bus(pc);
 
-        // Fetches data with proper addressing mode and executes instruction
-        uint8_t add_cycle_1 = (this->*instructions_table[_opcode].addr_mode)();
-        uint8_t add_cycle_2 = (this->*instructions_table[_opcode].operate)();
+            // Increment program counter
+            pc++;
 
-        // Add additional clock cycles (if exists)
-        _remaining_cycles += (add_cycle_1 & add_cycle_2);
+            // Fetches data with proper addressing mode and executes instruction
+            execute(_opcode);
+        }
 
         // Unused flag
         set_flag(U, true);
+        _instr_count++;
     }
 
     _clock_count++;
     _remaining_cycles--;
 }
 
+/* Runs a decoded instruction at the program counter, fused with the next one
+ * if 'fusion_window' allows. Returns whether it was */
+inline bool cpu6502::execute_decoded(const DecodedInstr &instr, uint32_t fusion_window) {
+    _opcode = instr.opcode;
+    _operand = instr.operand;
+    _decoded = true;
+    pc++;
+
+    bool fused = instr.fused && opcode_table[instr.opcode].cycles < fusion_window;
+    if (fused) {
+        _next_operand = instr.next_operand;
+        _fused_counts[instr.fused - 1]++;
+        (this->*fused_handlers[instr.fused - 1])();
+    }
+    else {
+        (this->*instr.handler)();
+    }
+    _decoded = false;
+    return fused;
+}
+
 /* Sets CPU back to known state after reset */
 void cpu6502::reset() {
     _addr_abs = RESET_PC;
@@ -71,11 +136,42 @@ void cpu6502::reset() {
 
     a = 0x00; x = 0x00; y = 0x00;
     stkp = RESET_STKP; status = 0x00 | U;
+    load_flags();
 
     _addr_rel = 0x0000; _addr_abs = 0x0000; _fetched = 0x00;
     _remaining_cycles = 8;
 }
 
+/* Copies the CPU state into 'state', flags are kept lazy */
+void cpu6502::save_state(State &state) {
+    state.a = a; state.x = x; state.y = y; state.stkp = stkp; state.status = status;
+    state.pc = pc;
+    state.fetched = _fetched;
+    state.temp = _temp; state.addr_abs = _addr_abs; state.addr_rel = _addr_rel;
+    state.opcode = _opcode;
+    state.instr_pc = _instr_pc; state.operand = _operand; state.next_operand = _next_operand;
+    state.implied = _implied; state.decoded = _decoded;
+    state.remaining_cycles = _remaining_cycles;
+    state.clock_count = _clock_count;
+    state.instr_count = _instr_count;
+    state.flag_n = _flag_n; state.flag_z = _flag_z; state.flag_c = _flag_c; state.flag_v = _flag_v;
+}
+
+/* Inverse of 'save_state()' */
+void cpu6502::load_state(const State &state) {
+    a = state.a; x = state.x; y = state.y; stkp = state.stkp; status = state.status;
+    pc = state.pc;
+    _fetched = state.fetched;
+    _temp = state.temp; _addr_abs = state.addr_abs; _addr_rel = state.addr_rel;
+    _opcode = state.opcode;
+    _instr_pc = state.instr_pc; _operand = state.operand; _next_operand = state.next_operand;
+    _implied = state.implied; _decoded = state.decoded;
+    _remaining_cycles = state.remaining_cycles;
+    _clock_count = state.clock_count;
+    _instr_count = state.instr_count;
+    _flag_n = state.flag_n; _flag_z = state.flag_z; _flag_c = state.flag_c; _flag_v = state.flag_v;
+}
+
 /* Interrupt request */
 void cpu6502::irq() {
     if (get_flag(I) == 0) {
@@ -89,6 +185,7 @@ void cpu6502::irq() {
         set_flag(U, true);
         set_flag(I, true);
         set_flag(B, false);
+        flush_flags();
 
         write_to_bus(BASE_STKP + stkp, status);
         stkp--;
@@ -115,6 +212,7 @@ void cpu6502::nmi() {
     set_flag(U, true);
     set_flag(I, true);
     set_flag(B, false);
+    flush_flags();
 
     write_to_bus(BASE_STKP + stkp, status);
     stkp--;
@@ -130,12 +228,232 @@ void cpu6502::nmi() {
 
 /* Populates the '_fetched' attribute */
 uint8_t cpu6502::fetch() {
-    if (!(instructions_table[_opcode].addr_mode == &cpu6502::IMP)) {
+    if (!_implied) {
         _fetched = read_from_bus(_addr_abs);
     }
     return _fetched;
 }
 
+/* Reads the next operand byte of the current instruction */
+uint8_t cpu6502::read_operand() {
+    uint8_t data = _decoded ? (_operand & 0x00FF) : read_from_bus(pc);
+    _operand >>= 8;
+    pc++;
+    return data;
+}
+
+/*=============================================================================
+ * INSTRUCTION DISPATCH
+ *===========================================================================*/
+/* Executes one instruction. Both the addressing mode and the operation are
+ * template arguments, so each opcode gets its own specialised function and
+ * calls them directly rather than through member function pointers */
+template <uint8_t (cpu6502::*operate)(void), uint8_t (cpu6502::*addr_mode)(void),
+          uint8_t cycles>
+inline void cpu6502::execute_op() {
+    _implied = (addr_mode == &cpu6502::IMP);
+    _remaining_cycles = cycles;
+
+    uint8_t add_cycle_1 = (this->*addr_mode)();
+    uint8_t add_cycle_2 = (this->*operate)();
+
+    // Add additional clock cycles (if exists)
+    _remaining_cycles += (add_cycle_1 & add_cycle_2);
+}
+
+#define INSTR_CASE(opcode, mnemonic, operate, addr_mode, cycles) \
+    case opcode: execute_op<&cpu6502::operate, &cpu6502::addr_mode, cycles>(); break;
+
+/* Dense switch over all 256 opcodes, generated from 'instructions.h' */
+void cpu6502::execute(uint8_t opcode) {
+    switch (opcode) {
+        CPU6502_INSTRUCTIONS(INSTR_CASE)
+    }
+}
+
+#undef INSTR_CASE
+
+#define INSTR_HANDLER(opcode, mnemonic, operate, addr_mode, cycles) \
+    &cpu6502::execute_op<&cpu6502::operate, &cpu6502::addr_mode, cycles>,
+
+/* Same specialisations as 'execute()', for the decoded instruction cache */
+void (cpu6502::*const cpu6502::handlers_table[256])(void) = {
+    CPU6502_INSTRUCTIONS(INSTR_HANDLER)
+};
+
+#undef INSTR_HANDLER
+
+/* Runs two instructions as one operation. The second one starts right where
+ * the first one ends, so only the clock cycles of both are added up */
+template <uint8_t (cpu6502::*operate_1)(void), uint8_t (cpu6502::*addr_mode_1)(void),
+          uint8_t cycles_1,
+          uint8_t (cpu6502::*operate_2)(void), uint8_t (cpu6502::*addr_mode_2)(void),
+          uint8_t cycles_2>
+void cpu6502::execute_pair() {
+    execute_op<operate_1, addr_mode_1, cycles_1>();
+    uint8_t first_cycles = _remaining_cycles;
+    _instr_count++;
+
+    _instr_pc = pc;
+    _operand = _next_operand;
+    pc++;
+
+    execute_op<operate_2, addr_mode_2, cycles_2>();
+    _remaining_cycles += first_cycles;
+}
+
+#define FUSED_PAIR(opcode_1, operate_1, addr_mode_1, cycles_1, \
+                   opcode_2, operate_2, addr_mode_2, cycles_2) \
+    &cpu6502::execute_pair<&cpu6502::operate_1, &cpu6502::addr_mode_1, cycles_1, \
+                           &cpu6502::operate_2, &cpu6502::addr_mode_2, cycles_2>,
+
+void (cpu6502::*const cpu6502::fused_handlers[])(void) = {
+    CPU6502_FUSED_PAIRS(FUSED_PAIR)
+};
+
+#undef FUSED_PAIR
+
+/* Fused instructions run without the bus clock moving in between, so neither
+ * one may access anything but RAM. PPU, APU and IO registers would see the
+ * access early, and so would mapper registers in cartridge space */
+bool cpu6502::leaves_ram(uint8_t opcode, uint16_t operand) {
+    return opcode_table[opcode].mode == addressing::ABS &&
+           operand > SYSTEM_RAM_ADDR_UPPER;
+}
+
+size_t cpu6502::num_fused_pairs() { return NUM_FUSED_PAIRS; }
+
+const char *cpu6502::fused_pair_name(size_t pair) { return fused_pairs[pair].name; }
+
+uint64_t cpu6502::get_fused_count(size_t pair) { return _fused_counts[pair]; }
+
+/*=============================================================================
+ * DECODED INSTRUCTION CACHE
+ *===========================================================================*/
+void cpu6502::reset_decoded_cache(size_t prg_size) {
+    _decoded_cache.assign(prg_size, DecodedInstr { nullptr, 0, 0, 0, 0, 0, 0 });
+    _block_instrs.assign(prg_size, 0);
+    _block_start.assign(prg_size, 0);
+    _block_code.clear();
+}
+
+/* Drops every decoded instruction and built block that covers PRG memory
+ * at 'prg_offset', including fused pairs */
+void cpu6502::invalidate_decoded(uint32_t prg_offset) {
+    for (uint32_t i = 0; i < 6 && i <= prg_offset; i++) {
+        DecodedInstr &instr = _decoded_cache[prg_offset - i];
+        if (instr.span > i) instr.handler = nullptr;
+    }
+
+    // Blocks never cross a CPU page, so they start at most 255 bytes before
+    uint32_t first = (prg_offset > 0xFF) ? prg_offset - 0xFF : 0;
+    memset(&_block_instrs[first], 0, prg_offset - first + 1);
+}
+
+/* Decoded instruction at 'addr', decoding it on first use. Returns nullptr
+ * for code outside of PRG memory (e.g. copied to RAM) and instructions
+ * running into the next page, which can be switched to another bank */
+const cpu6502::DecodedInstr *cpu6502::decoded_instr(uint16_t addr) {
+    assert(bus != nullptr);
+    int32_t offset = bus->get_prg_offset(addr);
+    if (offset < 0) return nullptr;
+
+    assert((size_t)offset < _decoded_cache.size());
+    DecodedInstr &instr = _decoded_cache[offset];
+    if (instr.handler) return &instr;
+
+    uint8_t opcode = read_from_bus(addr);
+    uint8_t length = opcode_table[opcode].length;
+    if ((addr & 0x00FF) + length > 0x0100) return nullptr;
+
+    instr.opcode = opcode;
+    instr.length = length;
+    instr.operand = 0x0000;
+    for (uint8_t i = 1; i < length; i++)
+        instr.operand |= (uint16_t)read_from_bus(addr + i) << ((i - 1) * 8);
+
+    instr.span = length;
+    instr.fused = 0;
+    instr.handler = handlers_table[opcode];
+
+    // Fuse with the next instruction when they form a known pair
+    for (size_t i = 0; i < NUM_FUSED_PAIRS && (addr & 0x00FF) + length < 0x0100; i++) {
+        if (fused_pairs[i].first != opcode) continue;
+
+        const DecodedInstr *next = decoded_instr(addr + length);
+        if (!next || next->opcode != fused_pairs[i].second) continue;
+        if (leaves_ram(opcode, instr.operand) || leaves_ram(next->opcode, next->operand))
+            break;
+
+        instr.next_operand = next->operand;
+        instr.span = length + next->length;
+        instr.fused = i + 1;
+        break;
+    }
+    return &instr;
+}
+
+/*=============================================================================
+ * BLOCK BACKEND
+ *===========================================================================*/
+void cpu6502::set_backend(backend b) { _backend = b; }
+
+cpu6502::backend cpu6502::get_backend() { return _backend; }
+
+/* Builds the basic block at the program counter on first use and makes it
+ * the one 'run_block_instr()' runs. A block runs up to and including the first
+ * control flow instruction and stops short of the next CPU page. Returns its
+ * number of instructions, 0 if the program counter is not in PRG memory */
+uint8_t cpu6502::build_block() {
+    assert(bus != nullptr);
+    int32_t offset = bus->get_prg_offset(pc);
+    if (offset < 0) return 0;
+    if (_block_instrs[offset]) {
+        _block = _block_start[offset];
+        return _block_instrs[offset];
+    }
+
+    // Blocks dropped by self-modifying code stay behind, start over when
+    // they add up
+    if (_block_code.size() >= MAX_BLOCK_CODE) {
+        _block_code.clear();
+        std::fill(_block_instrs.begin(), _block_instrs.end(), 0);
+    }
+
+    uint8_t num_instrs = 0;
+    uint16_t addr = pc;
+    const DecodedInstr *instr = nullptr;
+    _block = _block_code.size();
+
+    while ((instr = decoded_instr(addr)) != nullptr) {
+        _block_code.push_back(*instr);
+        num_instrs++;
+        if (opcode_table[instr->opcode].control_flow || (addr & 0x00FF) + instr->length > 0x00FF ||
+            num_instrs == UINT8_MAX) break;
+        addr += instr->length;
+    }
+
+    _block_instrs[offset] = num_instrs;
+    _block_start[offset] = _block;
+    return num_instrs;
+}
+
+/* Starts instruction 'idx' of the block 'build_block()' returned, which
+ * has to be the one at the program counter. A fused pair runs both of its
+ * instructions if the next 'fusion_window' clock cycles allow, see 'clock()'.
+ * Returns the number of instructions run */
+uint8_t cpu6502::run_block_instr(uint8_t idx, uint32_t fusion_window) {
+    assert(_remaining_cycles == 0);
+    _instr_pc = pc;
+    bool fused = execute_decoded(_block_code[_block + idx], fusion_window);
+
+    set_flag(U, true);
+    _instr_count++;
+    _clock_count++;
+    _remaining_cycles--;
+    return fused ? 2 : 1;
+}
+
 /*=============================================================================
  * UTILS FUNCTIONS
  *===========================================================================*/
@@ -160,62 +478,63 @@ std::map<uint16_t, std::string> cpu6502::disasm(uint16_t begin, uint16_t end) {
 
         uint8_t opcode = bus->read(addr, true);
         addr++;
-        instruction_str += instructions_table[opcode].mnemonic + " ";
+        const OpcodeInfo &info = opcode_table[opcode];
+        instruction_str += std::string(info.mnemonic) + " ";
 
-        if (instructions_table[opcode].addr_mode == &cpu6502::IMP) {
+        if (info.mode == addressing::IMP) {
             instruction_str += " {IMP}";
         }
-        else if (instructions_table[opcode].addr_mode == &cpu6502::IMM) {
+        else if (info.mode == addressing::IMM) {
             value = bus->read(addr, true);
             addr++;
             instruction_str += "#$" + hex_str(value, 2) + " {IMM}";
         }
-        else if (instructions_table[opcode].addr_mode == &cpu6502::ZP0) {
+        else if (info.mode == addressing::ZP0) {
             lo = bus->read(addr, true);
             addr++;
             hi = 0x00;
             instruction_str += "$" + hex_str(lo, 2) + " {ZP0}";
         }
-        else if (instructions_table[opcode].addr_mode == &cpu6502::ZPX) {
+        else if (info.mode == addressing::ZPX) {
             lo = bus->read(addr, true); addr++;
             hi = 0x00;
             instruction_str += "$" + hex_str(lo, 2) + ", X {ZPX}";
         }
-        else if (instructions_table[opcode].addr_mode == &cpu6502::ZPY) {
+        else if (info.mode == addressing::ZPY) {
             lo = bus->read(addr, true); addr++;
             hi = 0x00;
             instruction_str += "$" + hex_str(lo, 2) + ", Y {ZPY}";
         }
-        else if (instructions_table[opcode].addr_mode == &cpu6502::REL) {
+        else if (info.mode == addressing::REL) {
             value = bus->read(addr, true); addr++;
             instruction_str += "$" + hex_str(value, 2) + " [$" + hex_str(addr + (int8_t)value, 4) + "] {REL}";
         }
-        else if (instructions_table[opcode].addr_mode == &cpu6502::ABS) {
+        else if (info.mode == addressing::ABS) {
             lo = bus->read(addr, true); addr++;
             hi = bus->read(addr, true); addr++;
             instruction_str += "$" + hex_str((uint16_t)(hi << 8) | lo, 4) + " {ABS}";
         }
-        else if (instructions_table[opcode].addr_mode == &cpu6502::ABX) {
+        else if (info.mode == addressing::ABX) {
             lo = bus->read(addr, true); addr++;
             hi = bus->read(addr, true); addr++;
             instruction_str += "$" + hex_str((uint16_t)(hi << 8) | lo, 4) + ", X {ABX}";
         }
-        else if (instructions_table[opcode].addr_mode == &cpu6502::ABY) {
+        else if (info.mode == addressing::ABY) {
             lo = bus->read(addr, true); addr++;
             hi = bus->read(addr, true); addr++;
             instruction_str += "$" + hex_str((uint16_t)(hi << 8) | lo, 4) + ", Y {ABY}";
         }
-        else if (instructions_table[opcode].addr_mode == &cpu6502::IND) {
+        else if (info.mode == addressing::IND) {
             lo = bus->read(addr, true); addr++;
             hi = bus->read(addr, true); addr++;
             instruction_str += "($" + hex_str((uint16_t)(hi << 8) | lo, 4) + ") {IND}";
         }
-        else if (instructions_table[opcode].addr_mode == &cpu6502::IZX) {
+        else if (info.mode == addressing::IZX) {
             lo = bus->read(addr, true); addr++;
             hi = 0x00;
             instruction_str += "($" + hex_str(lo, 2) + ", X) {IZX}";
         }
-        else if (instructions_table[opcode].addr_mode == &cpu6502::IZY) {
+        else if (info.mode == addressing::IZY) {
             lo = bus->read(addr, true); addr++;
             hi = 0x00;
             instruction_str += "($" + hex_str(lo, 2) + "), Y {IZY}";
@@ -244,29 +563,25 @@ uint8_t cpu6502::IMM() {
 }
 
 uint8_t cpu6502::ZP0() {
-    _addr_abs = read_from_bus(pc);
-    pc++;
+    _addr_abs = read_operand();
     _addr_abs &= 0x00FF;
     return 0;
 }
 
 uint8_t cpu6502::ZPX() {
-    _addr_abs = read_from_bus(pc) + x;
-    pc++;
+    _addr_abs = read_operand() + x;
     _addr_abs &= 0x00FF;
     return 0;
 }
 
 uint8_t cpu6502::ZPY() {
-    _addr_abs = read_from_bus(pc) + y;
-    pc++;
+    _addr_abs = read_operand() + y;
     _addr_abs &= 0x00FF;
     return 0;
 }
 
 uint8_t cpu6502::REL() {
-    _addr_rel = read_from_bus(pc);
-    pc++;
+    _addr_rel = read_operand();
 
     // Handles negative _addr_rel case
     if (_addr_rel & 0x80) _addr_rel |= 0xFF00;
@@ -274,20 +589,16 @@ uint8_t cpu6502::REL() {
 }
 
 uint8_t cpu6502::ABS() {
-    uint16_t lo = read_from_bus(pc);
-    pc++;
-    uint16_t hi = read_from_bus(pc);
-    pc++;
+    uint16_t lo = read_operand();
+    uint16_t hi = read_operand();
 
     _addr_abs = (hi << 8) | lo;
     return 0;
 }
 
 uint8_t cpu6502::ABX() {
-    uint16_t lo = read_from_bus(pc);
-    pc++;
-    uint16_t hi = read_from_bus(pc);
-    pc++;
+    uint16_t lo = read_operand();
+    uint16_t hi = read_operand();
 
     _addr_abs = (hi << 8) | lo;
     _addr_abs += x;
@@ -297,10 +608,8 @@ uint8_t cpu6502::ABX() {
 }
 
 uint8_t cpu6502::ABY() {
-    uint16_t lo = read_from_bus(pc);
-    pc++;
-    uint16_t hi = read_from_bus(pc);
-    pc++;
+    uint16_t lo = read_operand();
+    uint16_t hi = read_operand();
 
     _addr_abs = (hi << 8) | lo;
     _addr_abs += y;
@@ -310,10 +619,8 @@ uint8_t cpu6502::ABY() {
 }
 
 uint8_t cpu6502::IND() {
-    uint16_t lo = read_from_bus(pc);
-    pc++;
-    uint16_t hi = read_from_bus(pc);
-    pc++;
+    uint16_t lo = read_operand();
+    uint16_t hi = read_operand();
 
     uint16_t ptr = (hi << 8) | lo;
     if (lo == 0x00FF)
@@ -325,8 +632,7 @@ uint8_t cpu6502::IND() {
 }
 
 uint8_t cpu6502::IZX() {
-    uint16_t t = read_from_bus(pc);
-    pc++;
+    uint16_t t = read_operand();
 
     uint16_t lo = read_from_bus((uint16_t)(t + (uint16_t)x) & 0x00FF);
     uint16_t hi = read_from_bus((uint16_t)(t + (uint16_t)x + 1) & 0x00FF);
@@ -337,8 +643,7 @@ uint8_t cpu6502::IZX() {
 }
 
 uint8_t cpu6502::IZY() {
-    uint16_t t = read_from_bus(pc);
-    pc++;
+    uint16_t t = read_operand();
 
     uint16_t lo = read_from_bus(t & 0x00FF);
     uint16_t hi = read_from_bus((t + 1) & 0x00FF);
@@ -354,14 +659,12 @@ uint8_t cpu6502::IZY() {
  *===========================================================================*/
 uint8_t cpu6502::ADC() {
     fetch();
-    _temp = (uint16_t)a + (uint16_t)_fetched + (uint16_t)get_flag(C);
+    _temp = (uint16_t)a + (uint16_t)_fetched + (uint16_t)_flag_c;
 
-    set_flag(C, _temp > 255);
-    set_flag(Z, (_temp & 0x00FF) == 0);
-    set_flag(V, (~((uint16_t)a ^ (uint16_t)_fetched) &
-                                    ((uint16_t)a ^ (uint16_t)_temp)) & 0x0080);
-    set_flag(N, _temp & 0x80);
+    _flag_c = _temp >> 8;
+    _flag_v = ~((uint16_t)a ^ (uint16_t)_fetched) & ((uint16_t)a ^ (uint16_t)_temp);
     a = _temp & 0x00FF;
+    set_nz(a);
 
     return 1;
 }
@@ -369,19 +672,17 @@ uint8_t cpu6502::ADC() {
 uint8_t cpu6502::AND() {
     fetch();
     a = a & _fetched;
-    set_flag(Z, a == 0x00);
-    set_flag(N, a & 0x80);
+    set_nz(a);
     return 1;
 }
 
 uint8_t cpu6502::ASL() {
     fetch();
     _temp = (uint16_t)_fetched << 1;
-    set_flag(C, (_temp & 0xFF00) > 0);
-    set_flag(Z, (_temp & 0x00FF) == 0x00);
-    set_flag(N, _temp & 0x80);
+    _flag_c = _temp >> 8;
+    set_nz(_temp & 0x00FF);
 
-    if (instructions_table[_opcode].addr_mode == &cpu6502::IMP)
+    if (_implied)
         a = _temp & 0x00FF;
     else
         write_to_bus(_addr_abs, _temp & 0x00FF);
@@ -389,7 +690,7 @@ uint8_t cpu6502::ASL() {
 }
 
 uint8_t cpu6502::BCC() {
-    if (get_flag(C) == 0) {
+    if (_flag_c == 0) {
         _remaining_cycles++;
         _addr_abs = pc + _addr_rel;
 
@@ -402,7 +703,7 @@ uint8_t cpu6502::BCC() {
 }
 
 uint8_t cpu6502::BCS() {
-    if (get_flag(C) == 1) {
+    if (_flag_c != 0) {
         _remaining_cycles++;
         _addr_abs = pc + _addr_rel;
 
@@ -415,7 +716,7 @@ uint8_t cpu6502::BCS() {
 }
 
 uint8_t cpu6502::BEQ() {
-    if (get_flag(Z) == 1) {
+    if (_flag_z == 0) {
         _remaining_cycles++;
         _addr_abs = pc + _addr_rel;
 
@@ -430,14 +731,14 @@ uint8_t cpu6502::BEQ() {
 uint8_t cpu6502::BIT() {
     fetch();
     _temp = a & _fetched;
-    set_flag(Z, (_temp & 0x00FF) == 0x00);
-    set_flag(N, _fetched & (0x1 << 7));
-    set_flag(V, _fetched & (0x1 << 6));
+    _flag_z = _temp & 0x00FF;
+    _flag_n = _fetched;
+    _flag_v = _fetched << 1;
     return 0;
 }
 
 uint8_t cpu6502::BMI() {
-    if (get_flag(N) == 1) {
+    if (_flag_n & 0x80) {
         _remaining_cycles++;
         _addr_abs = pc + _addr_rel;
 
@@ -450,7 +751,7 @@ uint8_t cpu6502::BMI() {
 }
 
 uint8_t cpu6502::BNE() {
-    if (get_flag(Z) == 0) {
+    if (_flag_z != 0) {
         _remaining_cycles++;
         _addr_abs = pc + _addr_rel;
 
@@ -463,7 +764,7 @@ uint8_t cpu6502::BNE() {
 }
 
 uint8_t cpu6502::BPL() {
-    if (get_flag(N) == 0) {
+    if (!(_flag_n & 0x80)) {
         _remaining_cycles++;
         _addr_abs = pc + _addr_rel;
 
@@ -485,6 +786,7 @@ uint8_t cpu6502::BRK() {
 
     set_flag(I, true);
     set_flag(B, true);
+    flush_flags();
     write_to_bus(BASE_STKP + stkp, status);
     stkp--;
 
@@ -495,7 +797,7 @@ uint8_t cpu6502::BRK() {
 }
 
 uint8_t cpu6502::BVC() {
-    if (get_flag(V) == 0) {
+    if (!(_flag_v & 0x80)) {
         _remaining_cycles++;
         _addr_abs = pc + _addr_rel;
 
@@ -508,7 +810,7 @@ uint8_t cpu6502::BVC() {
 }
 
 uint8_t cpu6502::BVS() {
-    if (get_flag(V) == 1) {
+    if (_flag_v & 0x80) {
         _remaining_cycles++;
         _addr_abs = pc + _addr_rel;
 
@@ -520,60 +822,55 @@ uint8_t cpu6502::BVS() {
     return 0;
 }
 
-uint8_t cpu6502::CLC() { set_flag(C, false); return 0; }
+uint8_t cpu6502::CLC() { _flag_c = 0; return 0; }
 
 uint8_t cpu6502::CLD() { set_flag(D, false); return 0; }
 
 uint8_t cpu6502::CLI() { set_flag(I, false); return 0; }
 
-uint8_t cpu6502::CLV() { set_flag(V, false); return 0; }
+uint8_t cpu6502::CLV() { _flag_v = 0; return 0; }
 
 uint8_t cpu6502::CMP() {
     fetch();
     _temp = (uint16_t)a - (uint16_t)_fetched;
-    set_flag(C, a >= _fetched);
-    set_flag(Z, (_temp & 0x00FF) == 0x0000);
-    set_flag(N, _temp & 0x0080);
+    _flag_c = a >= _fetched;
+    set_nz(_temp & 0x00FF);
     return 1;
 }
 
 uint8_t cpu6502::CPX() {
     fetch();
     _temp = (uint16_t)x - (uint16_t)_fetched;
-    set_flag(C, x >= _fetched);
-    set_flag(N, _temp & 0x0080);
-    set_flag(Z, (_temp & 0x00FF) == 0x0000);
+    _flag_c = x >= _fetched;
+    set_nz(_temp & 0x00FF);
     return 0;
 }
 
 uint8_t cpu6502::CPY() {
     fetch();
     _temp = (uint16_t)y - (uint16_t)_fetched;
-    set_flag(C, y >= _fetched);
-    set_flag(N, _temp & 0x0080);
-    set_flag(Z, (_temp & 0x00FF) == 0x0000);
+    _flag_c = y >= _fetched;
+    set_nz(_temp & 0x00FF);
     return 0;
 }
 
 uint8_t cpu6502::DEC() {
     fetch();
     _temp = _fetched - 1;
-    set_flag(Z, (_temp & 0x00FF) == 0x0000);
-    set_flag(N, _temp & 0x0080);
+    set_nz(_temp & 0x00FF);
 
     write_to_bus(_addr_abs, _temp & 0x00FF);
     return 0;
 }
 
-uint8_t cpu6502::DEX() { x--; set_flag(Z, x == 0x00); set_flag(N, x & 0x80); return 0; }
+uint8_t cpu6502::DEX() { x--; set_nz(x); return 0; }
 
-uint8_t cpu6502::DEY() { y--; set_flag(Z, y == 0x00); set_flag(N, y & 0x80); return 0; }
+uint8_t cpu6502::DEY() { y--; set_nz(y); return 0; }
 
 uint8_t cpu6502::EOR() {
     fetch();
     a = a ^ _fetched;
-    set_flag(Z, a == 0x00);
-    set_flag(N, a & 0x80);
+    set_nz(a);
     return 1;
 }
 
@@ -581,14 +878,13 @@ uint8_t cpu6502::INC() {
     fetch();
     _temp = _fetched + 1;
     write_to_bus(_addr_abs, _temp & 0x00FF);
-    set_flag(Z, (_temp & 0x00FF) == 0x0000);
-    set_flag(N, _temp & 0x0080);
+    set_nz(_temp & 0x00FF);
     return 0;
 }
 
-uint8_t cpu6502::INX() { x++; set_flag(Z, x == 0x00); set_flag(N, x & 0x80); return 0; }
+uint8_t cpu6502::INX() { x++; set_nz(x); return 0; }
 
-uint8_t cpu6502::INY() { y++; set_flag(Z, y == 0x00); set_flag(N, y & 0x80); return 0; }
+uint8_t cpu6502::INY() { y++; set_nz(y); return 0; }
 
 uint8_t cpu6502::JMP() { pc = _addr_abs;  return 0; }
 
@@ -605,36 +901,31 @@ uint8_t cpu6502::JSR() {
 uint8_t cpu6502::LDA() {
     fetch();
     a = _fetched;
-    set_flag(Z, a == 0x00);
-    set_flag(N, a & 0x80);
+    set_nz(a);
     return 1;
 }
 
 uint8_t cpu6502::LDX() {
     fetch();
     x = _fetched;
-    set_flag(Z, x == 0x00);
-    set_flag(N, x & 0x80);
+    set_nz(x);
     return 1;
 }
 
 uint8_t cpu6502::LDY() {
     fetch();
     y = _fetched;
-    set_flag(Z, y == 0x00);
-    set_flag(N, y & 0x80);
+    set_nz(y);
     return 1;
 }
 
 uint8_t cpu6502::LSR() {
     fetch();
     _temp = _fetched >> 1;
+    _flag_c = _fetched & 0x01;
+    set_nz(_temp & 0x00FF);
 
-    set_flag(C, _fetched & 0x0001);
-    set_flag(Z, (_temp & 0x00FF) == 0x0000);
-    set_flag(N, _temp & 0x0080);
-
-    if (instructions_table[_opcode].addr_mode == &cpu6502::IMP)
+    if (_implied)
         a = _temp & 0x00FF;
     else
         write_to_bus(_addr_abs, _temp & 0x00FF);
@@ -657,8 +948,7 @@ uint8_t cpu6502::NOP() {
 uint8_t cpu6502::ORA() {
     fetch();
     a |= _fetched;
-    set_flag(Z, a == 0x00);
-    set_flag(N, a & 0x80);
+    set_nz(a);
     return 1;
 }
 
@@ -669,6 +959,7 @@ uint8_t cpu6502::PHA() {
 }
 
 uint8_t cpu6502::PHP() {
+    flush_flags();
     write_to_bus(BASE_STKP + stkp, status | B | U);
     set_flag(B, false);
     set_flag(U, false);
@@ -679,8 +970,7 @@ uint8_t cpu6502::PHP() {
 uint8_t cpu6502::PLA() {
     stkp++;
     a = read_from_bus(BASE_STKP + stkp);
-    set_flag(Z, a == 0x00);
-    set_flag(N, a & 0x80);
+    set_nz(a);
     return 0;
 }
 
@@ -688,17 +978,17 @@ uint8_t cpu6502::PLP() {
     stkp++;
     status = read_from_bus(BASE_STKP + stkp);
     set_flag(U, 1);
+    load_flags();
     return 0;
 }
 
 uint8_t cpu6502::ROL() {
     fetch();
+    _temp = (uint16_t)(_fetched << 1) | _flag_c;
+    _flag_c = _temp >> 8;
+    set_nz(_temp & 0x00FF);
 
-    _temp = (uint16_t)(_fetched << 1) | get_flag(C);
-    set_flag(N, _temp & 0x0080);
-    set_flag(Z, (_temp & 0x00FF) == 0x0000);
-    set_flag(C, _temp & 0xFF00);
-    if (instructions_table[_opcode].addr_mode == &cpu6502::IMP)
+    if (_implied)
         a = _temp & 0x00FF;
     else
         write_to_bus(_addr_abs, _temp & 0x00FF);
@@ -707,11 +997,11 @@ uint8_t cpu6502::ROL() {
 
 uint8_t cpu6502::ROR() {
     fetch();
-    _temp = (uint16_t)(get_flag(C) << 7) | (_fetched >> 1);
-    set_flag(N, _temp & 0x0080);
-    set_flag(Z, (_temp & 0x00FF) == 0x00);
-    set_flag(C, _fetched & 0x01);
-    if (instructions_table[_opcode].addr_mode == &cpu6502::IMP)
+    _temp = (uint16_t)(_flag_c << 7) | (_fetched >> 1);
+    _flag_c = _fetched & 0x01;
+    set_nz(_temp & 0x00FF);
+
+    if (_implied)
         a = _temp & 0x00FF;
     else
         write_to_bus(_addr_abs, _temp & 0x00FF);
@@ -723,6 +1013,7 @@ uint8_t cpu6502::RTI() {
     status = read_from_bus(BASE_STKP + stkp);
     status &= ~U;
     status &= ~B;
+    load_flags();
 
     stkp++;
     pc = (uint16_t)read_from_bus(BASE_STKP + stkp);
@@ -744,18 +1035,16 @@ uint8_t cpu6502::RTS() {
 uint8_t cpu6502::SBC() {
     fetch();
     uint16_t val = ((uint16_t)_fetched) ^ 0x00FF;
-    _temp = (uint16_t)a + val + (uint16_t)get_flag(C);
-
-    set_flag(C, _temp & 0xFF00);
-    set_flag(Z, ((_temp & 0x00FF) == 0));
-    set_flag(V, (_temp ^ (uint16_t)a) & (_temp ^ val) & 0x0080);
-    set_flag(N, _temp & 0x0080);
+    _temp = (uint16_t)a + val + (uint16_t)_flag_c;
 
+    _flag_c = _temp >> 8;
+    _flag_v = (_temp ^ (uint16_t)a) & (_temp ^ val);
     a = _temp & 0x00FF;
+    set_nz(a);
     return 1;
 }
 
-uint8_t cpu6502::SEC() { set_flag(C, true); return 0; }
+uint8_t cpu6502::SEC() { _flag_c = 1; return 0; }
 
 uint8_t cpu6502::SED() { set_flag(D, true); return 0; }
 
@@ -767,18 +1056,41 @@ uint8_t cpu6502::STX() { write_to_bus(_addr_abs, x); return 0; }
 
 uint8_t cpu6502::STY() { write_to_bus(_addr_abs, y); return 0; }
 
-uint8_t cpu6502::TAX() { x = a; set_flag(Z, x == 0x00); set_flag(N, x & 0x80); return 0; }
+uint8_t cpu6502::TAX() { x = a; set_nz(x); return 0; }
 
-uint8_t cpu6502::TAY() { y = a; set_flag(Z, y == 0x00); set_flag(N, y & 0x80); return 0; }
+uint8_t cpu6502::TAY() { y = a; set_nz(y); return 0; }
 
-uint8_t cpu6502::TSX() { x = stkp; set_flag(Z, x == 0x00); set_flag(N, x & 0x80); return 0; }
+uint8_t cpu6502::TSX() { x = stkp; set_nz(x); return 0; }
 
-uint8_t cpu6502::TXA() { a = x; set_flag(Z, a == 0x00); set_flag(N, a & 0x80); return 0; }
+uint8_t cpu6502::TXA() { a = x; set_nz(a); return 0; }
 
 uint8_t cpu6502::TXS() { stkp = x; return 0; }
 
-uint8_t cpu6502::TYA() { a = y; set_flag(Z, a == 0x00); set_flag(N, a & 0x80); return 0; }
+uint8_t cpu6502::TYA() { a = y; set_nz(a); return 0; }
 
 uint8_t cpu6502::XXX() { return 0; }
 
 bool cpu6502::instr_completed() { return _remaining_cycles == 0; }
+
+uint32_t cpu6502::get_clock_count() { return _clock_count; }
+
+uint64_t cpu6502::get_instr_count() { return _instr_count; }
+
+uint8_t cpu6502::get_remaining_cycles() { return _remaining_cycles; }
+
+/* Same as calling 'clock()' 'cycles' times while an instruction is in flight */
+void cpu6502::skip_cycles(uint8_t cycles) {
+    assert(cycles <= _remaining_cycles);
+    _remaining_cycles -= cycles;
+    _clock_count += cycles;
+}
+
+uint16_t cpu6502::get_instr_pc() { return _instr_pc; }
+
+/* Accounts for 'instrs' instructions taking 'cycles' clock cycles that left
+ * the CPU state unchanged, see 'Bus::skip_idle_loop()' */
+void cpu6502::skip_instrs(uint64_t instrs, uint32_t cycles) {
+    assert(_remaining_cycles == 0);
+    _instr_count += instrs;
+    _clock_count += cycles;
+}
@@ -41,7 +41,7 @@ public:
     uint8_t  y;                         // Y register
     uint8_t  stkp;                      // Stack pointer
     uint16_t pc;                        // Program counter
-    uint8_t  status;                    // Status register
+    uint8_t  status;                    // Status register (see 'flush_flags()')
 
 // 6502 CPU's internal state helper attributes
 private:
@@ -50,14 +50,21 @@ private:
     uint16_t _addr_abs;
     uint16_t _addr_rel;
     uint8_t  _opcode;
+    uint16_t _instr_pc;                 // Address of the last instruction
+    uint16_t _operand;                  // Operand bytes of a decoded instruction
+    uint16_t _next_operand;             // Operand bytes of the second fused one
+    bool     _implied;                  // Current instruction uses IMP mode
+    bool     _decoded;                  // Current instruction is from the cache
     uint8_t  _remaining_cycles;
     uint32_t _clock_count;
+    uint64_t _instr_count;
 
     uint8_t fetch();
+    uint8_t read_operand();
 
 // 6502 CPU internal state methods
 public:
-    void clock();
+    void clock(uint32_t fusion_window = 0);
     void reset();
     void irq();
     void nmi();
@@ -67,6 +74,20 @@ private:
     uint8_t get_flag(flags f);
     void    set_flag(flags f, bool v);
 
+// Lazy flags - N, Z, C and V are kept as the raw results that produced them
+// and only folded into 'status' when it is pushed or inspected
+private:
+    uint8_t _flag_n;                    // N is bit 7
+    uint8_t _flag_z;                    // Z is set when zero
+    uint8_t _flag_c;                    // C is bit 0
+    uint8_t _flag_v;                    // V is bit 7
+
+    void set_nz(uint8_t result);
+    void load_flags();
+
+public:
+    void flush_flags();
+
 // Addressing modes for 6502 instructions
 private:
     uint8_t IMP();	uint8_t IMM();
@@ -76,17 +97,82 @@ private:
     uint8_t ABY();	uint8_t IND();
     uint8_t IZX();	uint8_t IZY();
 
-// Opcodes for 6502 instructions
+// Opcodes for 6502 instructions, see 'opcode_table' for their metadata
+private:
+    // Opcode dispatch: one 'execute_op' specialisation per opcode
+    void execute(uint8_t opcode);
+
+    template <uint8_t (cpu6502::*operate)(void), uint8_t (cpu6502::*addr_mode)(void),
+              uint8_t cycles>
+    void execute_op();
+
+    static void (cpu6502::*const handlers_table[256])(void);
+
+// Decoded instruction cache - ROM-resident instructions keyed by their PRG
+// memory offset, so they are fetched from the bus only once
+private:
+    struct DecodedInstr {
+        void (cpu6502::*handler)(void); // 'execute_op' specialisation
+        uint16_t operand;               // Operand bytes, little endian
+        uint16_t next_operand;          // Operand bytes of the second fused one
+        uint8_t  opcode;
+        uint8_t  length;                // Opcode and operand bytes
+        uint8_t  span;                  // Bytes covered, with the fused one
+        uint8_t  fused;                 // 1 + index in 'fused_pairs', or 0
+    };
+
+    std::vector<DecodedInstr> _decoded_cache;
+
+    const DecodedInstr *decoded_instr(uint16_t addr);
+    bool execute_decoded(const DecodedInstr &instr, uint32_t fusion_window);
+
+public:
+    void reset_decoded_cache(size_t prg_size);
+    void invalidate_decoded(uint32_t prg_offset);
+
+// Superinstructions - pairs of decoded instructions from 'instructions.h' run
+// as one operation, when the second one starts within the fusion window
 private:
-    struct Instruction {
-        std::string mnemonic;
-        uint8_t (cpu6502::*operate  ) (void);
-        uint8_t (cpu6502::*addr_mode) (void);
-        uint8_t cycles;
+    // 'execute_pair' specialisations, in the same order as 'fused_pairs'
+    static void (cpu6502::*const fused_handlers[])(void);
+    std::vector<uint64_t> _fused_counts;
+
+    template <uint8_t (cpu6502::*operate_1)(void), uint8_t (cpu6502::*addr_mode_1)(void),
+              uint8_t cycles_1,
+              uint8_t (cpu6502::*operate_2)(void), uint8_t (cpu6502::*addr_mode_2)(void),
+              uint8_t cycles_2>
+    void execute_pair();
+
+    static bool leaves_ram(uint8_t opcode, uint16_t operand);
+
+public:
+    static size_t num_fused_pairs();
+    static const char *fused_pair_name(size_t pair);
+    uint64_t get_fused_count(size_t pair);
+
+// Execution backends - threaded block dispatch copies ROM-resident basic
+// blocks out of the decoded instruction cache into arrays of instructions with
+// their handlers bound and operands decoded, which 'Bus::run_block()' runs
+// back to back without looking up any instruction. No machine code is
+// generated
+public:
+    enum backend : uint8_t {
+        INTERPRETER,                    // One instruction at a time
+        BLOCKS                          // Basic blocks, see 'Bus::run_block()'
     };
 
-    // Instructions lookup table
-    static const std::vector<Instruction> instructions_table;
+    void set_backend(backend b);
+    backend get_backend();
+    uint8_t build_block();
+    uint8_t run_block_instr(uint8_t idx, uint32_t fusion_window);
+
+private:
+    backend _backend;
+    std::vector<uint8_t> _block_instrs; // Block length at each PRG offset, 0 if
+                                        // not built
+    std::vector<uint32_t> _block_start; // Its first instruction in '_block_code'
+    std::vector<DecodedInstr> _block_code;  // Built blocks back to back
+    uint32_t _block;                    // Block 'build_block()' returned
 
     // Helper functions: update 6502's registers state from instructions
     uint8_t ADC();	uint8_t AND();	uint8_t ASL();	uint8_t BCC();
@@ -111,6 +197,38 @@ public:
     std::map<uint16_t, std::string> disasm(uint16_t begin, uint16_t end);
 
     bool instr_completed();
+
+    uint32_t get_clock_count();
+    uint64_t get_instr_count();
+
+    // Instruction granular execution (see 'Bus::clock_frame()')
+    uint8_t get_remaining_cycles();
+    void skip_cycles(uint8_t cycles);
+
+    // Idle loop fast-forward, last instruction address and skipped iterations
+    uint16_t get_instr_pc();
+    void skip_instrs(uint64_t instrs, uint32_t cycles);
+
+// Snapshots - registers and internal state, enough to carry on exactly where
+// the CPU was saved. Decoded instructions and built blocks only depend on
+// PRG memory, see 'Bus::load_state()'
+public:
+    struct State {
+        uint8_t  a, x, y, stkp, status;
+        uint16_t pc;
+        uint8_t  fetched;
+        uint16_t temp, addr_abs, addr_rel;
+        uint8_t  opcode;
+        uint16_t instr_pc, operand, next_operand;
+        bool     implied, decoded;
+        uint8_t  remaining_cycles;
+        uint32_t clock_count;
+        uint64_t instr_count;
+        uint8_t  flag_n, flag_z, flag_c, flag_v;
+    };
+
+    void save_state(State &state);
+    void load_state(const State &state);
 };
 
 #endif
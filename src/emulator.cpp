@@ -1,11 +1,23 @@
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <cmath>
+#include <cstring>
+#include <fstream>
 #include "emulator.h"
+#include "save_state.h"
 
 #define OPEN_SANS_FONT_DIR "utils/open-sans.ttf"
-static const std::chrono::duration<int, std::micro> REFRESH_PERIOD(12000);
 
-/* NES resolution */
-#define NES_WINDOW_WIDTH 256
-#define NES_WINDOW_HEIGHT 240
+/* NTSC frame rate is 60.0988 Hz, 29780.5 CPU cycles at 1.789773 MHz */
+static const std::chrono::nanoseconds FRAME_PERIOD(16639267);
+
+/* Frames the scheduler may fall behind by before it starts over from now */
+#define MAX_FRAME_LAG 3
+
+/* Longest sleep while waiting for events with emulation paused */
+#define IDLE_WAIT_MS 250
 
 /* GUI resolution */
 #define VIDEO_WIDTH 768
@@ -31,7 +43,12 @@ static const SDL_Color GREEN = { 0, 255, 0, 100 };
 /*=============================================================================
  * EMULATOR METHODS
  *===========================================================================*/
-Emulator::Emulator(Emulator::MODE m, const char *nes_file) : mode(m) {
+Emulator::Emulator(Emulator::MODE m, const char *nes_file, cpu6502::backend backend,
+                   ppu2C02::renderer ppu_renderer, uint32_t frameskip, bool vsync,
+                   uint32_t runahead) :
+    _frames(NES_WINDOW_WIDTH * NES_WINDOW_HEIGHT), _controllers(0), _running(false),
+    _input_time(0), _state_request(NO_REQUEST), mode(m)
+{
 
     // Create bus connection
     cpu.connect_to_bus(&main_bus);
@@ -42,10 +59,14 @@ Emulator::Emulator(Emulator::MODE m, const char *nes_file) : mode(m) {
 
     cartridge = std::make_shared<Cartridge>(nes_file);
     main_bus.connect_to_cartridge(cartridge);
+    main_bus.input_hook = [this]() { _sample_controllers(); };
 
+    cpu.set_backend(backend);
+    ppu.set_renderer(ppu_renderer);
     cpu.reset();
 
     SDL_Init(SDL_INIT_VIDEO);
+    if (vsync) SDL_SetHint(SDL_HINT_RENDER_VSYNC, "1");
 
     // Create window size based on mode
     if (mode == DEBUG_MODE) {
@@ -58,6 +79,25 @@ Emulator::Emulator(Emulator::MODE m, const char *nes_file) : mode(m) {
         _is_emulating = true;
     }
 
+    _redraw = true;
+    _controller_input[0] = _controller_input[1] = 0x00;
+    _vsync = vsync;
+    _last_frame_paced = false;
+    _paced_frames = 0;
+    _frame_time_sum = _frame_time_sq_sum = 0.0;
+    _frame_time_min = _frame_time_max = 0.0;
+    _latched_controllers = 0x0000;
+    _input_pending = false;
+    _inputs = _inputs_mid_frame = 0;
+    _input_latency_sum = _input_latency_max = 0.0;
+    _debug_text = nullptr;
+    _frameskip = std::max<uint32_t>(frameskip, 1);
+    _frame_count = 0;
+    _runahead = runahead;
+    _runahead_runs = 0;
+    _runahead_time_sum = 0.0;
+    _state_file = std::string(nes_file) + ".state";
+    _publish_frame();
     SDL_RenderClear(renderer);
     TTF_Init();
 }
@@ -74,9 +114,11 @@ void Emulator::_handle_debug_inputs() {
                 break;
             }
             case SDL_SCANCODE_F: {
-                do { main_bus.clock(); } while (!ppu.frame_completed());
+                ppu.set_output(true);
+                main_bus.clock_frame();
                 do { main_bus.clock(); } while (!cpu.instr_completed());
                 ppu.reset_frame();
+                _publish_frame();
                 break;
             }
             case SDL_SCANCODE_P: {
@@ -96,62 +138,120 @@ void Emulator::_handle_controller_inputs() {
     if (event.type == SDL_KEYDOWN) {
         switch (code) {
             // First controller: up, left, down, right
-            case SDL_SCANCODE_W:        main_bus.controller[0] |= 0x08; break;
-            case SDL_SCANCODE_A:        main_bus.controller[0] |= 0x02; break;
-            case SDL_SCANCODE_S:        main_bus.controller[0] |= 0x04; break;
-            case SDL_SCANCODE_D:        main_bus.controller[0] |= 0x01; break;
+            case SDL_SCANCODE_W:        _controller_input[0] |= 0x08; break;
+            case SDL_SCANCODE_A:        _controller_input[0] |= 0x02; break;
+            case SDL_SCANCODE_S:        _controller_input[0] |= 0x04; break;
+            case SDL_SCANCODE_D:        _controller_input[0] |= 0x01; break;
 
             // First controller: A, B, Select, Start
-            case SDL_SCANCODE_T:        main_bus.controller[0] |= 0x80; break;
-            case SDL_SCANCODE_Y:        main_bus.controller[0] |= 0x40; break;
-            case SDL_SCANCODE_LSHIFT:   main_bus.controller[0] |= 0x20; break;
-            case SDL_SCANCODE_RETURN:   main_bus.controller[0] |= 0x10; break;
+            case SDL_SCANCODE_T:        _controller_input[0] |= 0x80; break;
+            case SDL_SCANCODE_Y:        _controller_input[0] |= 0x40; break;
+            case SDL_SCANCODE_LSHIFT:   _controller_input[0] |= 0x20; break;
+            case SDL_SCANCODE_RETURN:   _controller_input[0] |= 0x10; break;
 
             // Second controller: up, left, down, right
-            case SDL_SCANCODE_UP:       main_bus.controller[1] |= 0x08; break;
-            case SDL_SCANCODE_LEFT:     main_bus.controller[1] |= 0x02; break;
-            case SDL_SCANCODE_DOWN:     main_bus.controller[1] |= 0x04; break;
-            case SDL_SCANCODE_RIGHT:    main_bus.controller[1] |= 0x01; break;
+            case SDL_SCANCODE_UP:       _controller_input[1] |= 0x08; break;
+            case SDL_SCANCODE_LEFT:     _controller_input[1] |= 0x02; break;
+            case SDL_SCANCODE_DOWN:     _controller_input[1] |= 0x04; break;
+            case SDL_SCANCODE_RIGHT:    _controller_input[1] |= 0x01; break;
 
             // Second controller: A, B, Select, Start
-            case SDL_SCANCODE_H:        main_bus.controller[1] |= 0x80; break;
-            case SDL_SCANCODE_J:        main_bus.controller[1] |= 0x40; break;
-            case SDL_SCANCODE_K:        main_bus.controller[1] |= 0x20; break;
-            case SDL_SCANCODE_L:        main_bus.controller[1] |= 0x10; break;
+            case SDL_SCANCODE_H:        _controller_input[1] |= 0x80; break;
+            case SDL_SCANCODE_J:        _controller_input[1] |= 0x40; break;
+            case SDL_SCANCODE_K:        _controller_input[1] |= 0x20; break;
+            case SDL_SCANCODE_L:        _controller_input[1] |= 0x10; break;
             default: break;
         }
     }
     else if (event.type == SDL_KEYUP) {
         switch (code) {
             // First controller: up, left, down, right
-            case SDL_SCANCODE_W:        main_bus.controller[0] &= ~0x08; break;
-            case SDL_SCANCODE_A:        main_bus.controller[0] &= ~0x02; break;
-            case SDL_SCANCODE_S:        main_bus.controller[0] &= ~0x04; break;
-            case SDL_SCANCODE_D:        main_bus.controller[0] &= ~0x01; break;
+            case SDL_SCANCODE_W:        _controller_input[0] &= ~0x08; break;
+            case SDL_SCANCODE_A:        _controller_input[0] &= ~0x02; break;
+            case SDL_SCANCODE_S:        _controller_input[0] &= ~0x04; break;
+            case SDL_SCANCODE_D:        _controller_input[0] &= ~0x01; break;
 
             // First controller: A, B, Select, Start
-            case SDL_SCANCODE_T:        main_bus.controller[0] &= ~0x80; break;
-            case SDL_SCANCODE_Y:        main_bus.controller[0] &= ~0x40; break;
-            case SDL_SCANCODE_LSHIFT:   main_bus.controller[0] &= ~0x20; break;
-            case SDL_SCANCODE_RETURN:   main_bus.controller[0] &= ~0x10; break;
+            case SDL_SCANCODE_T:        _controller_input[0] &= ~0x80; break;
+            case SDL_SCANCODE_Y:        _controller_input[0] &= ~0x40; break;
+            case SDL_SCANCODE_LSHIFT:   _controller_input[0] &= ~0x20; break;
+            case SDL_SCANCODE_RETURN:   _controller_input[0] &= ~0x10; break;
 
             // Second controller: up, left, down, right
-            case SDL_SCANCODE_UP:       main_bus.controller[1] &= ~0x08; break;
-            case SDL_SCANCODE_LEFT:     main_bus.controller[1] &= ~0x02; break;
-            case SDL_SCANCODE_DOWN:     main_bus.controller[1] &= ~0x04; break;
-            case SDL_SCANCODE_RIGHT:    main_bus.controller[1] &= ~0x01; break;
+            case SDL_SCANCODE_UP:       _controller_input[1] &= ~0x08; break;
+            case SDL_SCANCODE_LEFT:     _controller_input[1] &= ~0x02; break;
+            case SDL_SCANCODE_DOWN:     _controller_input[1] &= ~0x04; break;
+            case SDL_SCANCODE_RIGHT:    _controller_input[1] &= ~0x01; break;
 
             // Second controller: A, B, Select, Start
-            case SDL_SCANCODE_H:        main_bus.controller[1] &= ~0x80; break;
-            case SDL_SCANCODE_J:        main_bus.controller[1] &= ~0x40; break;
-            case SDL_SCANCODE_K:        main_bus.controller[1] &= ~0x20; break;
-            case SDL_SCANCODE_L:        main_bus.controller[1] &= ~0x10; break;
+            case SDL_SCANCODE_H:        _controller_input[1] &= ~0x80; break;
+            case SDL_SCANCODE_J:        _controller_input[1] &= ~0x40; break;
+            case SDL_SCANCODE_K:        _controller_input[1] &= ~0x20; break;
+            case SDL_SCANCODE_L:        _controller_input[1] &= ~0x10; break;
             default: break;
         }
     }
+
+    uint16_t controllers = _controller_input[0] | (_controller_input[1] << 8);
+    if (controllers != _controllers) {
+        _input_time = std::chrono::steady_clock::now().time_since_epoch().count();
+        _controllers = controllers;
+    }
+}
+
+void Emulator::_handle_state_inputs() {
+    if (event.type != SDL_KEYDOWN) return;
+    if (event.key.keysym.scancode == SDL_SCANCODE_F5) _state_request = SAVE_REQUEST;
+    else if (event.key.keysym.scancode == SDL_SCANCODE_F9) _state_request = LOAD_REQUEST;
+}
+
+/* Saves or loads the machine if a key asked for it. Runs between frames */
+void Emulator::_handle_state_request() {
+    uint8_t request = _state_request.exchange(NO_REQUEST);
+
+    if (request == SAVE_REQUEST) {
+        main_bus.save_state(_snapshot);
+        SaveState::write(_snapshot, *cartridge, _state_blob);
+
+        std::ofstream ofs(_state_file, std::ofstream::binary);
+        ofs.write((const char *)_state_blob.data(), _state_blob.size());
+        if (ofs) std::cout << "> Saved state to '" << _state_file << "'\n";
+        else std::cerr << "ERR: Cannot write file '" << _state_file << "'\n";
+    }
+    else if (request == LOAD_REQUEST) {
+        std::ifstream ifs(_state_file, std::ifstream::binary);
+        if (!ifs.is_open()) {
+            std::cerr << "ERR: Cannot open file '" << _state_file << "'\n";
+            return;
+        }
+        _state_blob.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+
+        if (!SaveState::read(_state_blob, *cartridge, _snapshot)) {
+            std::cerr << "ERR: '" << _state_file << "' is not a save state of this ROM\n";
+            return;
+        }
+        main_bus.load_state(_snapshot);
+        std::cout << "> Loaded state from '" << _state_file << "'\n";
+    }
 }
 
-/* Begin emulation */
+/* Handles the event in 'event', returns false when the window is closed */
+bool Emulator::_handle_event() {
+    if (event.type == SDL_QUIT) { stop(); return false; }
+
+    _handle_controller_inputs();
+    _handle_state_inputs();
+    if (mode == DEBUG_MODE) {
+        _handle_debug_inputs();
+        _handle_state_request();
+    }
+    _redraw = true;
+    return true;
+}
+
+/* Begin emulation. Frames are emulated on a fixed schedule, on the emulation
+ * thread in normal mode. The window is only redrawn after a new frame or an
+ * event, in between this thread sleeps */
 void Emulator::begin() {
     using namespace std::chrono;
 
@@ -159,24 +259,206 @@ void Emulator::begin() {
     if (mode == DEBUG_MODE) _init_debugging_gui_renderer();
     assert(renderer);
 
+    _next_frame = steady_clock::now();
+    if (mode == NORMAL_MODE) {
+        _running = true;
+        _emulation_thread = std::thread(&Emulator::_emulate, this);
+    }
+
     while (true) {
-        SDL_RenderClear(renderer);
-        SDL_PollEvent(&event);
+        while (SDL_PollEvent(&event)) {
+            if (!_handle_event()) return;
+        }
 
-        _handle_controller_inputs();
-        if (mode == DEBUG_MODE) _handle_debug_inputs();
-        if (event.type == SDL_QUIT) { stop(); return; }
+        steady_clock::time_point now = steady_clock::now();
+        if (mode == DEBUG_MODE) {
+            if (!_is_emulating) _last_frame_paced = false;
+            else if (now >= _frame_due()) { _run_frame(now); _redraw = true; }
+        }
 
-        if (_is_emulating && system_clock::now() - _start > REFRESH_PERIOD) {
-            do { main_bus.clock(); } while (!ppu.frame_completed());
-            ppu.reset_frame();
-            _start = system_clock::now();
+        if (_redraw) {
+            SDL_RenderClear(renderer);
+            if (mode == DEBUG_MODE) _render_debugging_gui();
+            _render_video();
+            SDL_RenderPresent(renderer);
+            _redraw = false;
         }
+        else if (!_wait_for_event(now)) {
+            return;
+        }
+    }
+}
+
+/* Emulation thread, runs frames on schedule until 'stop()' */
+void Emulator::_emulate() {
+    using namespace std::chrono;
+
+    while (_running) {
+        _handle_state_request();
+
+        steady_clock::time_point now = steady_clock::now();
+        if (now >= _frame_due()) _run_frame(now);
+        else std::this_thread::sleep_until(_frame_due());
+    }
+}
+
+/* Earliest time the next frame may run. With vsync on the SDL thread, frames
+ * run on the display refresh closest to their schedule, presenting blocks
+ * until then */
+std::chrono::steady_clock::time_point Emulator::_frame_due() {
+    return (_vsync && mode == DEBUG_MODE) ? _next_frame - FRAME_PERIOD / 2 : _next_frame;
+}
+
+/* Hands the PPU output over to the SDL thread and wakes it up */
+void Emulator::_publish_frame() {
+    std::memcpy(_frames.back(), ppu.get_indexed_frame(), NES_WINDOW_WIDTH * NES_WINDOW_HEIGHT);
+    _frames.publish();
+
+    SDL_Event frame_event = SDL_Event();
+    frame_event.type = SDL_USEREVENT;
+    SDL_PushEvent(&frame_event);
+}
+
+/* Emulates one frame. The next one is due a frame period after this one was,
+ * so that timing errors do not add up. After a stall (e.g. pausing or a slow
+ * host) the schedule starts over instead of running a burst of frames */
+void Emulator::_run_frame(std::chrono::steady_clock::time_point now) {
+    using namespace std::chrono;
+
+    // Inputs latched while stepping through the debugger are not counted
+    _input_pending = false;
+    _frame_start = now;
+    bool output = _frame_count++ % _frameskip == 0;
+    ppu.set_output(output && _runahead == 0);
+    main_bus.clock_frame();
+    ppu.reset_frame();
+    if (_runahead > 0) _run_ahead(output);
+    else if (output) _publish_frame();
+    _finish_input_latency(steady_clock::now());
+
+    if (_last_frame_paced) {
+        double ms = duration<double, std::milli>(now - _last_frame).count();
+        _frame_time_sum += ms;
+        _frame_time_sq_sum += ms * ms;
+        _frame_time_min = (_paced_frames == 0) ? ms : std::min(_frame_time_min, ms);
+        _frame_time_max = (_paced_frames == 0) ? ms : std::max(_frame_time_max, ms);
+        _paced_frames++;
+    }
 
-        if (mode == DEBUG_MODE) _render_debugging_gui();
-        _render_video();
-        SDL_RenderPresent(renderer);
+    _next_frame += FRAME_PERIOD;
+    _last_frame_paced = (now - _next_frame < MAX_FRAME_LAG * FRAME_PERIOD);
+    if (!_last_frame_paced) _next_frame = now + FRAME_PERIOD;
+    _last_frame = now;
+}
+
+/* Emulates the frames ahead of the one that just ran, publishes the last one
+ * if 'output' is set and rolls the machine back. Strobes in the hidden frames
+ * are not real input latches, so the latency bookkeeping is rolled back too */
+void Emulator::_run_ahead(bool output) {
+    using namespace std::chrono;
+    steady_clock::time_point start = steady_clock::now();
+
+    uint16_t latched_controllers = _latched_controllers;
+    bool input_pending = _input_pending;
+    steady_clock::time_point input_changed = _input_changed;
+
+    main_bus.save_state(_snapshot);
+    for (uint32_t i = 1; i <= _runahead; i++) {
+        ppu.set_output(output && i == _runahead);
+        main_bus.clock_frame();
+        ppu.reset_frame();
+    }
+    if (output) _publish_frame();
+    main_bus.load_state(_snapshot);
+
+    _latched_controllers = latched_controllers;
+    _input_pending = input_pending;
+    _input_changed = input_changed;
+
+    _runahead_time_sum += duration<double, std::milli>(steady_clock::now() - start).count();
+    _runahead_runs++;
+}
+
+/* Sleeps until the next event, new frames from the emulation thread included.
+ * When frames run on this thread, sleeps until the next one is due at most.
+ * SDL only waits whole milliseconds, so the last one before the frame is
+ * slept without waiting for events. Returns false when the window is closed
+ * in the meantime */
+bool Emulator::_wait_for_event(std::chrono::steady_clock::time_point now) {
+    using namespace std::chrono;
+
+    int timeout = IDLE_WAIT_MS;
+    if (mode == DEBUG_MODE && _is_emulating)
+        timeout = duration_cast<milliseconds>(_frame_due() - now).count() - 1;
+
+    if (timeout <= 0) {
+        std::this_thread::sleep_until(_frame_due());
+        return true;
     }
+    return SDL_WaitEventTimeout(&event, timeout) ? _handle_event() : true;
+}
+
+/* Controller strobe, hands the latest buttons from the SDL thread to the game */
+void Emulator::_sample_controllers() {
+    using namespace std::chrono;
+
+    uint16_t controllers = _controllers;
+    main_bus.controller[0] = controllers & 0xFF;
+    main_bus.controller[1] = controllers >> 8;
+
+    if (controllers != _latched_controllers && !_input_pending) {
+        _input_changed = steady_clock::time_point(steady_clock::duration(_input_time));
+        _input_pending = true;
+    }
+    _latched_controllers = controllers;
+}
+
+/* Counts the input latched during the frame that just finished, if any. Inputs
+ * that came in after the frame started would have waited for the next one
+ * had the controllers been sampled at the start of the frame */
+void Emulator::_finish_input_latency(std::chrono::steady_clock::time_point now) {
+    if (!_input_pending) return;
+
+    double ms = std::chrono::duration<double, std::milli>(now - _input_changed).count();
+    _input_latency_sum += ms;
+    _input_latency_max = std::max(_input_latency_max, ms);
+    if (_input_changed > _frame_start) _inputs_mid_frame++;
+    _inputs++;
+    _input_pending = false;
+}
+
+/* Reports the delay from button changes to the end of the frames reading them */
+void Emulator::_print_input_stats() {
+    if (_inputs == 0) return;
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "> Input latency    : " << _input_latency_sum / _inputs << " ms mean, "
+              << _input_latency_max << " ms max (" << _inputs << " inputs)"
+              << "\n> Sampled mid-frame: " << _inputs_mid_frame << " inputs, a frame earlier than"
+              << " sampling at frame start\n";
+    _inputs = 0;
+}
+
+/* Reports how close the frame intervals came to the NTSC frame period */
+void Emulator::_print_frame_stats() {
+    if (_paced_frames == 0) return;
+
+    double target = std::chrono::duration<double, std::milli>(FRAME_PERIOD).count();
+    double mean = _frame_time_sum / _paced_frames;
+    double jitter = std::sqrt(std::max(_frame_time_sq_sum / _paced_frames - mean * mean, 0.0));
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "> Paced frames     : " << _paced_frames << " (target " << target << " ms)"
+              << "\n> Frame time       : " << mean << " ms mean, " << _frame_time_min
+              << " ms min, " << _frame_time_max << " ms max"
+              << "\n> Frame jitter     : " << jitter << " ms std dev\n";
+    _paced_frames = 0;
+
+    if (_runahead_runs == 0) return;
+    double runahead_ms = _runahead_time_sum / _runahead_runs;
+    std::cout << "> Run-ahead        : " << _runahead << " frames, " << runahead_ms
+              << " ms extra per frame, " << runahead_ms / _runahead << " ms per frame ahead\n";
+    _runahead_runs = 0;
 }
 
 /* Stop emulation */
@@ -184,6 +466,16 @@ void Emulator::stop() {
     assert(window);
     assert(renderer);
 
+    _running = false;
+    if (_emulation_thread.joinable()) _emulation_thread.join();
+
+    _print_frame_stats();
+    _print_input_stats();
+    if (_debug_text) {
+        SDL_DestroyTexture(_debug_text);
+        _debug_text = nullptr;
+    }
+
     TTF_Quit();
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
@@ -202,11 +494,16 @@ void Emulator::_init_video_renderer() {
     assert(renderer);
     video_text = std::make_shared<Texture>(renderer,
                             NES_WINDOW_WIDTH, NES_WINDOW_HEIGHT, video_rect);
-    ppu.set_video_texture(video_text);
 }
 
+/* Expands the latest published frame right into the texture memory, once
+ * per frame */
 void Emulator::_render_video() {
     assert(video_text);
+    if (_frames.update()) {
+        ppu2C02::expand_frame(_frames.front(), video_text->lock_pixels());
+        video_text->unlock_pixels();
+    }
     video_text->render_texture();
 }
 
@@ -219,30 +516,70 @@ void Emulator::_init_debugging_gui_renderer() {
     _init_disasm_renderer();
     _init_palette_selection_renderer();
     _init_chr_rom_renderer();
+
+    // Transparent texture covering the debugging display, text is drawn into it
+    _debug_text_rect.x = VIDEO_WIDTH;
+    _debug_text_rect.y = 0;
+    _debug_text_rect.w = DEBUG_WIDTH - VIDEO_WIDTH;
+    _debug_text_rect.h = DEBUG_HEIGHT;
+
+    assert(renderer);
+    _debug_text = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET,
+                                    _debug_text_rect.w, _debug_text_rect.h);
+    assert(_debug_text);
+    SDL_SetTextureBlendMode(_debug_text, SDL_BLENDMODE_BLEND);
+    _debug_gui_valid = false;
 }
 
 void Emulator::_render_debugging_gui() {
-    _render_flags();
-    _render_regs();
-    _render_disasm();
-    _render_palette_selection();
-    _render_chr_rom();
-}
+    assert(renderer);
 
-void Emulator::_render_str(const std::string &str, TTF_Font *font,
-                                     const SDL_Color &col, SDL_Rect &bound) {
-    SDL_Surface *surf = TTF_RenderText_Solid(font, str.c_str(), col);
-    assert(surf);
-    SDL_Texture *text = SDL_CreateTextureFromSurface(renderer, surf);
-    assert(text);
+    // Flags, registers and disassembly only change when the CPU steps
+    if (!_debug_gui_valid || cpu.get_instr_count() != _gui_instr_count ||
+        cpu.pc != _gui_pc) {
+        SDL_SetRenderTarget(renderer, _debug_text);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+        SDL_RenderClear(renderer);
 
-    bound.w = surf->w;      // Resize boundaries box's width
-    bound.h = surf->h;      // Rezize boundaries box's height
+        _render_flags();
+        _render_regs();
+        _render_disasm();
 
-    SDL_FreeSurface(surf);
-    assert(renderer);
-    SDL_RenderCopy(renderer, text, nullptr, &bound);
-    SDL_DestroyTexture(text);
+        SDL_SetRenderTarget(renderer, nullptr);
+        SDL_SetRenderDrawColor(renderer, 25, 25, 25, 100);
+        _gui_instr_count = cpu.get_instr_count();
+        _gui_pc = cpu.pc;
+    }
+    SDL_RenderCopy(renderer, _debug_text, nullptr, &_debug_text_rect);
+
+    // Palettes and pattern tables only change with CHR and palette memory
+    uint32_t chr_serial = ppu.get_chr_serial();
+    uint32_t palette_serial = ppu.get_palette_serial();
+    bool palettes_changed = !_debug_gui_valid || palette_serial != _gui_palette_serial;
+    bool chr_changed = palettes_changed || chr_serial != _gui_chr_serial ||
+                       _curr_palette_selection != _gui_palette_selection;
+
+    _render_palette_selection(palettes_changed);
+    _render_chr_rom(chr_changed);
+
+    _gui_chr_serial = chr_serial;
+    _gui_palette_serial = palette_serial;
+    _gui_palette_selection = _curr_palette_selection;
+    _debug_gui_valid = true;
+}
+
+/* Draws into the debugging display text texture, 'bound' is in window
+ * coordinates and gets resized to the text */
+void Emulator::_render_str(const std::string &str, const std::shared_ptr<FontAtlas> &font,
+                                     const SDL_Color &col, SDL_Rect &bound) {
+    assert(font);
+    SDL_Rect text_bound = bound;
+    text_bound.x -= _debug_text_rect.x;
+    text_bound.y -= _debug_text_rect.y;
+    font->render_str(str, col, text_bound);
+
+    bound.w = text_bound.w;
+    bound.h = text_bound.h;
 }
 
 /*=============================================================================
@@ -261,7 +598,7 @@ void Emulator::_init_palette_selection_renderer() {
     }
 }
 
-void Emulator::_render_palette_selection() {
+void Emulator::_render_palette_selection(bool redraw) {
     assert(renderer);
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
     SDL_RenderDrawLine(
@@ -272,7 +609,7 @@ void Emulator::_render_palette_selection() {
     SDL_SetRenderDrawColor(renderer, 25, 25, 25, 100);
 
     for (uint8_t i = 0; i < NUM_PALETTE_SELECTION; ++i) {
-        ppu.get_palettes_texture(palettes_texts[i], i);
+        if (redraw) ppu.get_palettes_texture(palettes_texts[i]->get_pixels(), i);
         palettes_texts[i]->render_texture();
     }
 }
@@ -293,9 +630,11 @@ void Emulator::_init_chr_rom_renderer() {
                             CHR_ROM_SIZE, CHR_ROM_SIZE, chr_rom_rects[1]);
 }
 
-void Emulator::_render_chr_rom() {
-    ppu.get_chr_rom_texture(chr_rom_texts[0], 0, _curr_palette_selection);
-    ppu.get_chr_rom_texture(chr_rom_texts[1], 1, _curr_palette_selection);
+void Emulator::_render_chr_rom(bool redraw) {
+    if (redraw) {
+        ppu.get_chr_rom_texture(chr_rom_texts[0]->get_pixels(), 0, _curr_palette_selection);
+        ppu.get_chr_rom_texture(chr_rom_texts[1]->get_pixels(), 1, _curr_palette_selection);
+    }
 
     for (const auto &text : chr_rom_texts) text->render_texture();
 }
@@ -304,7 +643,7 @@ void Emulator::_render_chr_rom() {
  * CPU REGISTERS GUI RENDERER
  *===========================================================================*/
 void Emulator::_init_regs_renderer() {
-    regs_font = TTF_OpenFont(OPEN_SANS_FONT_DIR, 18);
+    regs_font = std::make_shared<FontAtlas>(renderer, OPEN_SANS_FONT_DIR, 18);
     assert(regs_font);
 
     // A register                           // X register
@@ -343,7 +682,7 @@ void Emulator::_render_regs() {
  * CPU FLAGS GUI RENDERER
  *===========================================================================*/
 void Emulator::_init_flags_renderer() {
-    flags_font = TTF_OpenFont(OPEN_SANS_FONT_DIR, 18);
+    flags_font = std::make_shared<FontAtlas>(renderer, OPEN_SANS_FONT_DIR, 18);
     assert(flags_font);
 
     for (int i = 0; i < NUM_FLAGS; ++i) {
@@ -354,6 +693,7 @@ void Emulator::_init_flags_renderer() {
 
 void Emulator::_render_flags() {
     assert(flags_font);
+    cpu.flush_flags();
     for (int i = 0; i < NUM_FLAGS; ++i) {
         if (cpu.status & (0x80 >> i))
             _render_str(FLAGS_CHAR[i], flags_font, GREEN, flags_rects[i]);
@@ -366,7 +706,7 @@ void Emulator::_render_flags() {
  * DISASSEMBLED INSTRUCTIONS GUI RENDERER
  *===========================================================================*/
 void Emulator::_init_disasm_renderer() {
-    disasm_font = TTF_OpenFont(OPEN_SANS_FONT_DIR, 14);
+    disasm_font = std::make_shared<FontAtlas>(renderer, OPEN_SANS_FONT_DIR, 14);
     assert(disasm_font);
     for (int i = 0; i < NUM_DISASM_INSTR; ++i) {
         disasm_instr_rects[i].x = VIDEO_WIDTH + 10;
@@ -5,10 +5,16 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <map>
+#include <string>
+#include <vector>
 #include <chrono>
+#include <atomic>
+#include <thread>
 
 #include "bus.h"
 #include "texture.h"
+#include "font_atlas.h"
+#include "triple_buffer.h"
 
 class Emulator {
 public:
@@ -21,11 +27,99 @@ private:
    std::shared_ptr<Cartridge> cartridge;
 
 private:
-    std::chrono::time_point<std::chrono::system_clock> _start;
     bool _is_emulating;
+    bool _redraw;               // Window contents out of date
+    uint32_t _frameskip;        // Only every '_frameskip'th frame has video output
+    uint64_t _frame_count;
+    bool _handle_event();
     void _handle_controller_inputs();
     void _handle_debug_inputs();
 
+/*=============================================================================
+ * Emulation thread - in normal mode the machine runs on its own thread. It
+ * publishes frames through '_frames' and picks up the controller state from
+ * '_controllers', nothing else is shared with the SDL thread. The debugger
+ * inspects and steps the machine, so debug mode runs it on the SDL thread
+ *===========================================================================*/
+private:
+    TripleBuffer _frames;               // Indexed frames, see 'ppu2C02'
+    uint8_t _controller_input[2];       // Buttons held, owned by the SDL thread
+    std::atomic<uint16_t> _controllers; // Snapshot of '_controller_input'
+
+    std::thread _emulation_thread;
+    std::atomic<bool> _running;
+
+    void _emulate();
+    void _publish_frame();
+
+/*=============================================================================
+ * Input sampling - the controllers are read from '_controllers' when the game
+ * strobes them, not at the start of the frame. Input latency is measured from
+ * the button change on the SDL thread to the end of the frame that read it
+ *===========================================================================*/
+private:
+    std::atomic<int64_t> _input_time;   // Last change of '_controllers', steady clock ticks
+    uint16_t _latched_controllers;
+    bool _input_pending;                // Latched a change its frame has not finished yet
+    std::chrono::steady_clock::time_point _input_changed;
+    std::chrono::steady_clock::time_point _frame_start;
+
+    uint64_t _inputs, _inputs_mid_frame;
+    double _input_latency_sum, _input_latency_max;
+
+    void _sample_controllers();
+    void _finish_input_latency(std::chrono::steady_clock::time_point now);
+    void _print_input_stats();
+
+/*=============================================================================
+ * Frame pacing
+ *===========================================================================*/
+private:
+    bool _vsync;                // Presenting waits for the display refresh
+    std::chrono::steady_clock::time_point _next_frame;
+    std::chrono::steady_clock::time_point _last_frame;
+    bool _last_frame_paced;     // Last frame ran on schedule, its interval counts
+
+    // Intervals between emulated frames, in milliseconds
+    uint64_t _paced_frames;
+    double _frame_time_sum, _frame_time_sq_sum;
+    double _frame_time_min, _frame_time_max;
+
+    std::chrono::steady_clock::time_point _frame_due();
+    void _run_frame(std::chrono::steady_clock::time_point now);
+    bool _wait_for_event(std::chrono::steady_clock::time_point now);
+    void _print_frame_stats();
+
+/*=============================================================================
+ * Run-ahead - each frame is followed by '_runahead' frames with the same input,
+ * which provide the video output and are rolled back to '_snapshot'. Hides
+ * that many frames of the game's own input lag
+ *===========================================================================*/
+private:
+    uint32_t _runahead;
+    Bus::State _snapshot;
+
+    // Time spent running ahead, in milliseconds
+    uint64_t _runahead_runs;
+    double _runahead_time_sum;
+
+    void _run_ahead(bool output);
+
+/*=============================================================================
+ * Save states - F5 saves the machine to '<ROM file>.state', F9 loads it back.
+ * Key presses only request it, the machine is saved or loaded between frames
+ * on the thread running them. '_snapshot' is the scratch state
+ *===========================================================================*/
+private:
+    enum STATE_REQUEST : uint8_t { NO_REQUEST, SAVE_REQUEST, LOAD_REQUEST };
+
+    std::atomic<uint8_t> _state_request;
+    std::string _state_file;
+    std::vector<uint8_t> _state_blob;
+
+    void _handle_state_inputs();
+    void _handle_state_request();
+
 /*=============================================================================
  * GUI attributes
  *===========================================================================*/
@@ -43,7 +137,10 @@ private:
 
 /* Emulator methods */
 public:
-    Emulator(MODE m, const char *nes_file);
+    Emulator(MODE m, const char *nes_file,
+             cpu6502::backend backend = cpu6502::INTERPRETER,
+             ppu2C02::renderer ppu_renderer = ppu2C02::DOT,
+             uint32_t frameskip = 1, bool vsync = false, uint32_t runahead = 0);
     ~Emulator();
 
     void begin();
@@ -56,9 +153,20 @@ private:
     void _init_debugging_gui_renderer();
     void _render_debugging_gui();
 
+    // Text panels are drawn into '_debug_text' when the CPU steps, graphics
+    // panels are refilled when CHR or palette memory changes
+    SDL_Texture *_debug_text;
+    SDL_Rect _debug_text_rect;
+    bool _debug_gui_valid;
+    uint64_t _gui_instr_count;
+    uint16_t _gui_pc;
+    uint32_t _gui_chr_serial;
+    uint32_t _gui_palette_serial;
+    uint8_t _gui_palette_selection;
+
 /* Render string helper function */
 private:
-    void _render_str(const std::string &str, TTF_Font *font,
+    void _render_str(const std::string &str, const std::shared_ptr<FontAtlas> &font,
                                         const SDL_Color &col, SDL_Rect &bound);
 
 /* GUI helper: palette selection display */
@@ -67,18 +175,18 @@ private:
     std::shared_ptr<Texture> palettes_texts[8];
     SDL_Rect palettes_rects[8];
     void _init_palette_selection_renderer();
-    void _render_palette_selection();
+    void _render_palette_selection(bool redraw);
 
 /* GUI helper: pattern memory (CHR ROM) display */
 private:
     std::shared_ptr<Texture> chr_rom_texts[2];
     SDL_Rect chr_rom_rects[2];
     void _init_chr_rom_renderer();
-    void _render_chr_rom();
+    void _render_chr_rom(bool redraw);
 
 /* GUI helper: Disassembler output display */
 private:
-    TTF_Font *disasm_font;
+    std::shared_ptr<FontAtlas> disasm_font;
     SDL_Rect disasm_instr_rects[25];
 
     std::map<uint16_t, std::string>_disasm_instr_map;
@@ -87,7 +195,7 @@ private:
 
 /* GUI helper: Registers display */
 private:
-    TTF_Font *regs_font;
+    std::shared_ptr<FontAtlas> regs_font;
     SDL_Rect regs_rects[5];
 
     void _init_regs_renderer();
@@ -95,7 +203,7 @@ private:
 
 /* GUI helper: Flags status bar */
 private:
-    TTF_Font *flags_font;
+    std::shared_ptr<FontAtlas> flags_font;
     SDL_Rect flags_rects[8];
 
     void _init_flags_renderer();
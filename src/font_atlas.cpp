@@ -0,0 +1,59 @@
+#include <cassert>
+#include "font_atlas.h"
+
+/* Constructor */
+FontAtlas::FontAtlas(SDL_Renderer *_renderer, const char *font_file, int size) :
+    renderer(_renderer), texture(nullptr), height(0)
+{
+    assert(_renderer);
+    TTF_Font *font = TTF_OpenFont(font_file, size);
+    assert(font);
+
+    std::string chars;
+    for (char c = FIRST_GLYPH; c <= LAST_GLYPH; c++) chars += c;
+
+    // Each glyph ends where the text up to and including it does
+    int x = 0;
+    for (size_t i = 0; i < chars.size(); i++) {
+        int w = 0;
+        TTF_SizeText(font, chars.substr(0, i + 1).c_str(), &w, &height);
+        glyphs[i].x = x;
+        glyphs[i].y = 0;
+        glyphs[i].w = w - x;
+        x = w;
+    }
+    for (SDL_Rect &glyph : glyphs) glyph.h = height;
+
+    // Rendered in white, color modulation tints it when drawn
+    const SDL_Color white = { 255, 255, 255, 255 };
+    SDL_Surface *surf = TTF_RenderText_Solid(font, chars.c_str(), white);
+    assert(surf);
+    texture = SDL_CreateTextureFromSurface(renderer, surf);
+    assert(texture);
+
+    SDL_FreeSurface(surf);
+    TTF_CloseFont(font);
+}
+
+/* Destructor */
+FontAtlas::~FontAtlas() { assert(texture); SDL_DestroyTexture(texture); }
+
+/* Render string at the top left corner of 'bound', resized to fit the text */
+void FontAtlas::render_str(const std::string &str, const SDL_Color &col, SDL_Rect &bound) {
+    assert(texture);
+    SDL_SetTextureColorMod(texture, col.r, col.g, col.b);
+
+    SDL_Rect dst = bound;
+    dst.h = height;
+    for (char c : str) {
+        if (c < FIRST_GLYPH || c > LAST_GLYPH) c = '?';
+        const SDL_Rect &glyph = glyphs[c - FIRST_GLYPH];
+
+        dst.w = glyph.w;
+        SDL_RenderCopy(renderer, texture, &glyph, &dst);
+        dst.x += glyph.w;
+    }
+
+    bound.w = dst.x - bound.x;
+    bound.h = height;
+}
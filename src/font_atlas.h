@@ -0,0 +1,27 @@
+#ifndef FONT_ATLAS_H_
+#define FONT_ATLAS_H_
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <string>
+
+/* Printable ASCII glyphs of a font, rendered once into a single texture. Text
+ * is drawn by copying glyphs out of it, tinted with the requested color */
+class FontAtlas {
+public:
+    FontAtlas(SDL_Renderer *_renderer, const char *font_file, int size);
+    ~FontAtlas();
+
+    void render_str(const std::string &str, const SDL_Color &col, SDL_Rect &bound);
+
+private:
+    static const char FIRST_GLYPH = ' ';
+    static const char LAST_GLYPH = '~';
+
+    SDL_Renderer *renderer;
+    SDL_Texture *texture;
+    int height;
+    SDL_Rect glyphs[LAST_GLYPH - FIRST_GLYPH + 1];  // Glyph boundaries in 'texture'
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+#include "headless.h"
+#include "save_state.h"
+
+/*=============================================================================
+ * HEADLESS METHODS
+ *===========================================================================*/
+Headless::Headless(const char *nes_file, cpu6502::backend backend,
+                   ppu2C02::renderer renderer) :
+    nes_file(nes_file), frameskip(1), frame_count(0), runahead(0)
+{
+    // Create bus connection
+    cpu.connect_to_bus(&main_bus);
+    main_bus.connect_to_cpu(&cpu);
+
+    ppu.connect_to_bus(&main_bus);
+    main_bus.connect_to_ppu(&ppu);
+
+    cartridge = std::make_shared<Cartridge>(nes_file);
+    main_bus.connect_to_cartridge(cartridge);
+
+    cpu.set_backend(backend);
+    ppu.set_renderer(renderer);
+    cpu.reset();
+}
+
+Headless::~Headless() {}
+
+/* Emulates until the PPU completes one frame. With run-ahead, the frame runs
+ * without video output and the frames ahead of it are emulated and undone */
+void Headless::run_frame() {
+    bool output = frame_count % frameskip == 0;
+    frame_count++;
+
+    ppu.set_output(output && runahead == 0);
+    main_bus.clock_frame();
+    ppu.reset_frame();
+    if (runahead == 0) return;
+
+    main_bus.save_state(snapshot);
+    for (uint32_t i = 1; i <= runahead; i++) {
+        ppu.set_output(output && i == runahead);
+        main_bus.clock_frame();
+        ppu.reset_frame();
+    }
+    main_bus.load_state(snapshot);
+}
+
+/* Renders only every 'n'th frame, the others run without video output */
+void Headless::set_frameskip(uint32_t n) { frameskip = std::max<uint32_t>(n, 1); }
+
+/* Shows the video output of 'n' frames ahead, 0 turns run-ahead off */
+void Headless::set_runahead(uint32_t n) { runahead = n; }
+
+/* Runs 'num_frames' frames as fast as possible and reports emulation speed */
+void Headless::benchmark(uint32_t num_frames) {
+    using namespace std::chrono;
+
+    uint64_t start_instrs = cpu.get_instr_count();
+    uint64_t start_dots = main_bus.get_clock_cycles();
+    uint64_t start_idle_cycles = main_bus.get_idle_cycles();
+    std::vector<uint64_t> start_fused(cpu6502::num_fused_pairs());
+    for (size_t i = 0; i < start_fused.size(); i++) start_fused[i] = cpu.get_fused_count(i);
+    steady_clock::time_point start = steady_clock::now();
+
+    for (uint32_t i = 0; i < num_frames; i++) run_frame();
+
+    double secs = duration<double>(steady_clock::now() - start).count();
+    if (secs <= 0.0) secs = 1e-9;
+
+    uint64_t instrs = cpu.get_instr_count() - start_instrs;
+    uint64_t dots = main_bus.get_clock_cycles() - start_dots;
+    uint64_t idle_cycles = main_bus.get_idle_cycles() - start_idle_cycles;
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "> Frames           : " << num_frames << " in " << secs << " s"
+              << "\n> Frames/sec       : " << num_frames / secs
+              << "\n> CPU instrs/sec   : " << instrs / secs
+              << "\n> PPU dots/sec     : " << dots / secs
+              << "\n> Idle CPU cycles  : " << idle_cycles << " skipped ("
+              << 100.0 * idle_cycles / std::max<uint64_t>(dots / 3, 1) << " %)\n";
+
+    // Superinstructions, how often each fused pair fired
+    for (size_t i = 0; i < start_fused.size(); i++) {
+        std::cout << "> Fused " << std::left << std::setw(11)
+                  << cpu6502::fused_pair_name(i) << std::right
+                  << ": " << cpu.get_fused_count(i) - start_fused[i] << "\n";
+    }
+
+    // Same frames on a fresh machine rendering all of them, for comparison
+    if (frameskip > 1) {
+        Headless full(nes_file.c_str(), cpu.get_backend(), ppu.get_renderer());
+        start = steady_clock::now();
+        for (uint32_t i = 0; i < num_frames; i++) full.run_frame();
+
+        double full_secs = duration<double>(steady_clock::now() - start).count();
+        if (full_secs <= 0.0) full_secs = 1e-9;
+
+        std::cout << "> Frameskip " << std::left << std::setw(7) << frameskip << std::right
+                  << ": " << full_secs / secs << "x speedup over full rendering ("
+                  << num_frames / full_secs << " frames/sec)\n";
+    }
+
+    // Binary save state round trips on the current state
+    const uint32_t round_trips = 1000;
+    std::vector<uint8_t> blob;
+    start = steady_clock::now();
+    for (uint32_t i = 0; i < round_trips; i++) save_state(blob);
+    steady_clock::time_point saved = steady_clock::now();
+    for (uint32_t i = 0; i < round_trips; i++) load_state(blob);
+
+    std::cout << "> Save state       : " << blob.size() << " bytes, "
+              << duration<double, std::micro>(saved - start).count() / round_trips << " us save, "
+              << duration<double, std::micro>(steady_clock::now() - saved).count() / round_trips
+              << " us load\n";
+
+    // Same frames without run-ahead, the difference is its cost
+    if (runahead > 0) {
+        Headless plain(nes_file.c_str(), cpu.get_backend(), ppu.get_renderer());
+        plain.set_frameskip(frameskip);
+        start = steady_clock::now();
+        for (uint32_t i = 0; i < num_frames; i++) plain.run_frame();
+
+        double plain_secs = duration<double>(steady_clock::now() - start).count();
+        double extra_ms = 1000.0 * std::max(secs - plain_secs, 0.0) / num_frames;
+
+        // Snapshot round trips on the current state
+        start = steady_clock::now();
+        for (uint32_t i = 0; i < round_trips; i++) main_bus.save_state(snapshot);
+        saved = steady_clock::now();
+        for (uint32_t i = 0; i < round_trips; i++) main_bus.load_state(snapshot);
+
+        double save_us = duration<double, std::micro>(saved - start).count() / round_trips;
+        double load_us = duration<double, std::micro>(steady_clock::now() - saved).count() /
+                         round_trips;
+
+        std::cout << "> Run-ahead " << std::left << std::setw(7) << runahead << std::right
+                  << ": " << extra_ms << " ms extra per frame, " << extra_ms / runahead
+                  << " ms per frame ahead"
+                  << "\n> Snapshot         : " << save_us << " us save, "
+                  << load_us << " us load\n";
+    }
+}
+
+/* Runs 'num_frames' frames with the block backend and 'renderer' while a
+ * second machine on the interpreter and the dot renderer clocks tick by tick
+ * alongside it. CPU registers, cycle count and RAM of both are compared before
+ * every instruction. Writes to cartridge space, with the bus clock tick they
+ * reach the mapper at, and the video output are compared after every frame.
+ * Both machines run instructions from the same decoded instruction cache, so
+ * this checks block dispatch, not decoding. Returns false on the first
+ * mismatch */
+bool Headless::differential(const char *nes_file, uint32_t num_frames,
+                            ppu2C02::renderer renderer) {
+    Headless blocks(nes_file, cpu6502::BLOCKS, renderer);
+    Headless reference(nes_file, cpu6502::INTERPRETER);
+
+    // Mapper registers have to see writes at the same tick, e.g. for bank
+    // switches to land on the same PPU dot
+    typedef std::tuple<uint64_t, uint16_t, uint8_t> CartridgeWrite;
+    std::vector<CartridgeWrite> blocks_writes, reference_writes;
+    blocks.main_bus.cartridge_hook = [&](uint16_t addr, uint8_t data) {
+        blocks_writes.emplace_back(blocks.main_bus.get_clock_cycles(), addr, data);
+    };
+    reference.main_bus.cartridge_hook = [&](uint16_t addr, uint8_t data) {
+        reference_writes.emplace_back(reference.main_bus.get_clock_cycles(), addr, data);
+    };
+
+    bool matching = true;
+    blocks.main_bus.instr_hook = [&]() {
+        if (!matching) return;
+        reference.main_bus.clock_to_instr(blocks.cpu.get_instr_count());
+        if (blocks.same_state(reference)) return;
+
+        matching = false;
+        std::cout << "> Mismatch before instruction " << blocks.cpu.get_instr_count()
+                  << "\n>   Blocks      : " << blocks.state_str()
+                  << "\n>   Interpreter : " << reference.state_str()
+                  << (blocks.state_str() == reference.state_str() ?
+                      "\n>   RAM contents differ\n" : "\n");
+    };
+
+    uint32_t frame = 0;
+    for (; frame < num_frames && matching; frame++) {
+        blocks.run_frame();
+
+        // Catch the reference up to the end of the same frame
+        while (!reference.ppu.frame_completed()) reference.main_bus.clock();
+        reference.ppu.reset_frame();
+
+        if (matching && blocks_writes != reference_writes) {
+            matching = false;
+            std::cout << "> Mismatch in cartridge writes of frame " << frame + 1 << "\n";
+        }
+        blocks_writes.clear();
+        reference_writes.clear();
+
+        if (matching && memcmp(blocks.get_indexed_frame(), reference.get_indexed_frame(),
+                               NES_WINDOW_WIDTH * NES_WINDOW_HEIGHT) != 0) {
+            matching = false;
+            std::cout << "> Mismatch in video output of frame " << frame + 1 << "\n";
+        }
+    }
+
+    if (matching)
+        std::cout << "> Differential     : " << num_frames << " frames, "
+                  << blocks.cpu.get_instr_count() << " instructions match\n";
+    else
+        std::cout << "> Differential     : failed in frame " << frame << "\n";
+    return matching;
+}
+
+bool Headless::same_state(Headless &other) {
+    cpu.flush_flags();
+    other.cpu.flush_flags();
+
+    return cpu.pc == other.cpu.pc && cpu.a == other.cpu.a && cpu.x == other.cpu.x &&
+           cpu.y == other.cpu.y && cpu.stkp == other.cpu.stkp &&
+           cpu.status == other.cpu.status &&
+           cpu.get_instr_count() == other.cpu.get_instr_count() &&
+           main_bus.get_clock_cycles() == other.main_bus.get_clock_cycles() &&
+           memcmp(main_bus.cpu_ram, other.main_bus.cpu_ram, sizeof(main_bus.cpu_ram)) == 0;
+}
+
+std::string Headless::state_str() {
+    cpu.flush_flags();
+
+    return "PC:$" + cpu6502::hex_str(cpu.pc, 4) + " A:$" + cpu6502::hex_str(cpu.a, 2) +
+           " X:$" + cpu6502::hex_str(cpu.x, 2) + " Y:$" + cpu6502::hex_str(cpu.y, 2) +
+           " SP:$" + cpu6502::hex_str(cpu.stkp, 2) + " P:$" + cpu6502::hex_str(cpu.status, 2) +
+           " CYC:" + std::to_string(main_bus.get_clock_cycles());
+}
+
+/* Video output of the last frame as RGBA pixels, converted on each call */
+const uint8_t *Headless::get_frame_buffer() {
+    rgba_frame.resize(NES_WINDOW_WIDTH * NES_WINDOW_HEIGHT * 4);
+    ppu2C02::expand_frame(ppu.get_indexed_frame(), rgba_frame.data());
+    return rgba_frame.data();
+}
+
+/* Video output of the last frame as system palette indices, 1 byte per pixel */
+const uint8_t *Headless::get_indexed_frame() { return ppu.get_indexed_frame(); }
+
+/* Serializes the machine into 'blob' */
+void Headless::save_state(std::vector<uint8_t> &blob) {
+    main_bus.save_state(snapshot);
+    SaveState::write(snapshot, *cartridge, blob);
+}
+
+/* Restores the machine from 'blob', false if it does not hold a valid state
+ * for this ROM. The machine is left untouched then */
+bool Headless::load_state(const std::vector<uint8_t> &blob) {
+    if (!SaveState::read(blob, *cartridge, snapshot)) return false;
+    main_bus.load_state(snapshot);
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef HEADLESS_H_
+#define HEADLESS_H_
+
+#include <memory>
+#include <string>
+#include "bus.h"
+
+/* Emulation core without any video, audio or input backend. Used to run ROMs
+ * on machines without a display and to benchmark the emulator */
+class Headless {
+public:
+    Headless(const char *nes_file, cpu6502::backend backend = cpu6502::INTERPRETER,
+             ppu2C02::renderer renderer = ppu2C02::DOT);
+    ~Headless();
+
+    void run_frame();
+    void set_frameskip(uint32_t n);
+    void set_runahead(uint32_t n);
+    void benchmark(uint32_t num_frames);
+    static bool differential(const char *nes_file, uint32_t num_frames,
+                             ppu2C02::renderer renderer = ppu2C02::DOT);
+
+    const uint8_t *get_frame_buffer();
+    const uint8_t *get_indexed_frame();
+
+    // Binary save states, see 'SaveState'
+    void save_state(std::vector<uint8_t> &blob);
+    bool load_state(const std::vector<uint8_t> &blob);
+
+private:
+    Bus main_bus;
+    cpu6502 cpu;
+    ppu2C02 ppu;
+    std::shared_ptr<Cartridge> cartridge;
+    std::vector<uint8_t> rgba_frame;
+
+    std::string nes_file;
+    uint32_t frameskip;         // Only every 'frameskip'th frame has video output
+    uint64_t frame_count;
+
+    // Run-ahead - video output comes from 'runahead' frames ahead of the
+    // machine, emulated after a snapshot and rolled back afterwards
+    uint32_t runahead;
+    Bus::State snapshot;        // Also scratch space for save states
+
+    bool same_state(Headless &other);
+    std::string state_str();
+};
+
+#endif
@@ -0,0 +1,444 @@
+#ifndef INSTRUCTIONS_H_
+#define INSTRUCTIONS_H_
+
+#include "cpu.h"
+
+/* 6502 instruction set - opcode, mnemonic, operation, addressing mode and base
+ * clock cycles of every opcode. Expanded with an 'INSTR' macro into both the
+ * 'opcode_table' metadata below and the opcode dispatch of 'cpu6502' */
+#define CPU6502_INSTRUCTIONS(INSTR) \
+    INSTR(0x00, "BRK", BRK, IMM, 7) \
+    INSTR(0x01, "ORA", ORA, IZX, 6) \
+    INSTR(0x02, "???", XXX, IMP, 2) \
+    INSTR(0x03, "???", XXX, IMP, 8) \
+    INSTR(0x04, "???", NOP, IMP, 3) \
+    INSTR(0x05, "ORA", ORA, ZP0, 3) \
+    INSTR(0x06, "ASL", ASL, ZP0, 5) \
+    INSTR(0x07, "???", XXX, IMP, 5) \
+    INSTR(0x08, "PHP", PHP, IMP, 3) \
+    INSTR(0x09, "ORA", ORA, IMM, 2) \
+    INSTR(0x0A, "ASL", ASL, IMP, 2) \
+    INSTR(0x0B, "???", XXX, IMP, 2) \
+    INSTR(0x0C, "???", NOP, IMP, 4) \
+    INSTR(0x0D, "ORA", ORA, ABS, 4) \
+    INSTR(0x0E, "ASL", ASL, ABS, 6) \
+    INSTR(0x0F, "???", XXX, IMP, 6) \
+    INSTR(0x10, "BPL", BPL, REL, 2) \
+    INSTR(0x11, "ORA", ORA, IZY, 5) \
+    INSTR(0x12, "???", XXX, IMP, 2) \
+    INSTR(0x13, "???", XXX, IMP, 8) \
+    INSTR(0x14, "???", NOP, IMP, 4) \
+    INSTR(0x15, "ORA", ORA, ZPX, 4) \
+    INSTR(0x16, "ASL", ASL, ZPX, 6) \
+    INSTR(0x17, "???", XXX, IMP, 6) \
+    INSTR(0x18, "CLC", CLC, IMP, 2) \
+    INSTR(0x19, "ORA", ORA, ABY, 4) \
+    INSTR(0x1A, "???", NOP, IMP, 2) \
+    INSTR(0x1B, "???", XXX, IMP, 7) \
+    INSTR(0x1C, "???", NOP, IMP, 4) \
+    INSTR(0x1D, "ORA", ORA, ABX, 4) \
+    INSTR(0x1E, "ASL", ASL, ABX, 7) \
+    INSTR(0x1F, "???", XXX, IMP, 7) \
+    INSTR(0x20, "JSR", JSR, ABS, 6) \
+    INSTR(0x21, "AND", AND, IZX, 6) \
+    INSTR(0x22, "???", XXX, IMP, 2) \
+    INSTR(0x23, "???", XXX, IMP, 8) \
+    INSTR(0x24, "BIT", BIT, ZP0, 3) \
+    INSTR(0x25, "AND", AND, ZP0, 3) \
+    INSTR(0x26, "ROL", ROL, ZP0, 5) \
+    INSTR(0x27, "???", XXX, IMP, 5) \
+    INSTR(0x28, "PLP", PLP, IMP, 4) \
+    INSTR(0x29, "AND", AND, IMM, 2) \
+    INSTR(0x2A, "ROL", ROL, IMP, 2) \
+    INSTR(0x2B, "???", XXX, IMP, 2) \
+    INSTR(0x2C, "BIT", BIT, ABS, 4) \
+    INSTR(0x2D, "AND", AND, ABS, 4) \
+    INSTR(0x2E, "ROL", ROL, ABS, 6) \
+    INSTR(0x2F, "???", XXX, IMP, 6) \
+    INSTR(0x30, "BMI", BMI, REL, 2) \
+    INSTR(0x31, "AND", AND, IZY, 5) \
+    INSTR(0x32, "???", XXX, IMP, 2) \
+    INSTR(0x33, "???", XXX, IMP, 8) \
+    INSTR(0x34, "???", NOP, IMP, 4) \
+    INSTR(0x35, "AND", AND, ZPX, 4) \
+    INSTR(0x36, "ROL", ROL, ZPX, 6) \
+    INSTR(0x37, "???", XXX, IMP, 6) \
+    INSTR(0x38, "SEC", SEC, IMP, 2) \
+    INSTR(0x39, "AND", AND, ABY, 4) \
+    INSTR(0x3A, "???", NOP, IMP, 2) \
+    INSTR(0x3B, "???", XXX, IMP, 7) \
+    INSTR(0x3C, "???", NOP, IMP, 4) \
+    INSTR(0x3D, "AND", AND, ABX, 4) \
+    INSTR(0x3E, "ROL", ROL, ABX, 7) \
+    INSTR(0x3F, "???", XXX, IMP, 7) \
+    INSTR(0x40, "RTI", RTI, IMP, 6) \
+    INSTR(0x41, "EOR", EOR, IZX, 6) \
+    INSTR(0x42, "???", XXX, IMP, 2) \
+    INSTR(0x43, "???", XXX, IMP, 8) \
+    INSTR(0x44, "???", NOP, IMP, 3) \
+    INSTR(0x45, "EOR", EOR, ZP0, 3) \
+    INSTR(0x46, "LSR", LSR, ZP0, 5) \
+    INSTR(0x47, "???", XXX, IMP, 5) \
+    INSTR(0x48, "PHA", PHA, IMP, 3) \
+    INSTR(0x49, "EOR", EOR, IMM, 2) \
+    INSTR(0x4A, "LSR", LSR, IMP, 2) \
+    INSTR(0x4B, "???", XXX, IMP, 2) \
+    INSTR(0x4C, "JMP", JMP, ABS, 3) \
+    INSTR(0x4D, "EOR", EOR, ABS, 4) \
+    INSTR(0x4E, "LSR", LSR, ABS, 6) \
+    INSTR(0x4F, "???", XXX, IMP, 6) \
+    INSTR(0x50, "BVC", BVC, REL, 2) \
+    INSTR(0x51, "EOR", EOR, IZY, 5) \
+    INSTR(0x52, "???", XXX, IMP, 2) \
+    INSTR(0x53, "???", XXX, IMP, 8) \
+    INSTR(0x54, "???", NOP, IMP, 4) \
+    INSTR(0x55, "EOR", EOR, ZPX, 4) \
+    INSTR(0x56, "LSR", LSR, ZPX, 6) \
+    INSTR(0x57, "???", XXX, IMP, 6) \
+    INSTR(0x58, "CLI", CLI, IMP, 2) \
+    INSTR(0x59, "EOR", EOR, ABY, 4) \
+    INSTR(0x5A, "???", NOP, IMP, 2) \
+    INSTR(0x5B, "???", XXX, IMP, 7) \
+    INSTR(0x5C, "???", NOP, IMP, 4) \
+    INSTR(0x5D, "EOR", EOR, ABX, 4) \
+    INSTR(0x5E, "LSR", LSR, ABX, 7) \
+    INSTR(0x5F, "???", XXX, IMP, 7) \
+    INSTR(0x60, "RTS", RTS, IMP, 6) \
+    INSTR(0x61, "ADC", ADC, IZX, 6) \
+    INSTR(0x62, "???", XXX, IMP, 2) \
+    INSTR(0x63, "???", XXX, IMP, 8) \
+    INSTR(0x64, "???", NOP, IMP, 3) \
+    INSTR(0x65, "ADC", ADC, ZP0, 3) \
+    INSTR(0x66, "ROR", ROR, ZP0, 5) \
+    INSTR(0x67, "???", XXX, IMP, 5) \
+    INSTR(0x68, "PLA", PLA, IMP, 4) \
+    INSTR(0x69, "ADC", ADC, IMM, 2) \
+    INSTR(0x6A, "ROR", ROR, IMP, 2) \
+    INSTR(0x6B, "???", XXX, IMP, 2) \
+    INSTR(0x6C, "JMP", JMP, IND, 5) \
+    INSTR(0x6D, "ADC", ADC, ABS, 4) \
+    INSTR(0x6E, "ROR", ROR, ABS, 6) \
+    INSTR(0x6F, "???", XXX, IMP, 6) \
+    INSTR(0x70, "BVS", BVS, REL, 2) \
+    INSTR(0x71, "ADC", ADC, IZY, 5) \
+    INSTR(0x72, "???", XXX, IMP, 2) \
+    INSTR(0x73, "???", XXX, IMP, 8) \
+    INSTR(0x74, "???", NOP, IMP, 4) \
+    INSTR(0x75, "ADC", ADC, ZPX, 4) \
+    INSTR(0x76, "ROR", ROR, ZPX, 6) \
+    INSTR(0x77, "???", XXX, IMP, 6) \
+    INSTR(0x78, "SEI", SEI, IMP, 2) \
+    INSTR(0x79, "ADC", ADC, ABY, 4) \
+    INSTR(0x7A, "???", NOP, IMP, 2) \
+    INSTR(0x7B, "???", XXX, IMP, 7) \
+    INSTR(0x7C, "???", NOP, IMP, 4) \
+    INSTR(0x7D, "ADC", ADC, ABX, 4) \
+    INSTR(0x7E, "ROR", ROR, ABX, 7) \
+    INSTR(0x7F, "???", XXX, IMP, 7) \
+    INSTR(0x80, "???", NOP, IMP, 2) \
+    INSTR(0x81, "STA", STA, IZX, 6) \
+    INSTR(0x82, "???", NOP, IMP, 2) \
+    INSTR(0x83, "???", XXX, IMP, 6) \
+    INSTR(0x84, "STY", STY, ZP0, 3) \
+    INSTR(0x85, "STA", STA, ZP0, 3) \
+    INSTR(0x86, "STX", STX, ZP0, 3) \
+    INSTR(0x87, "???", XXX, IMP, 3) \
+    INSTR(0x88, "DEY", DEY, IMP, 2) \
+    INSTR(0x89, "???", NOP, IMP, 2) \
+    INSTR(0x8A, "TXA", TXA, IMP, 2) \
+    INSTR(0x8B, "???", XXX, IMP, 2) \
+    INSTR(0x8C, "STY", STY, ABS, 4) \
+    INSTR(0x8D, "STA", STA, ABS, 4) \
+    INSTR(0x8E, "STX", STX, ABS, 4) \
+    INSTR(0x8F, "???", XXX, IMP, 4) \
+    INSTR(0x90, "BCC", BCC, REL, 2) \
+    INSTR(0x91, "STA", STA, IZY, 6) \
+    INSTR(0x92, "???", XXX, IMP, 2) \
+    INSTR(0x93, "???", XXX, IMP, 6) \
+    INSTR(0x94, "STY", STY, ZPX, 4) \
+    INSTR(0x95, "STA", STA, ZPX, 4) \
+    INSTR(0x96, "STX", STX, ZPY, 4) \
+    INSTR(0x97, "???", XXX, IMP, 4) \
+    INSTR(0x98, "TYA", TYA, IMP, 2) \
+    INSTR(0x99, "STA", STA, ABY, 5) \
+    INSTR(0x9A, "TXS", TXS, IMP, 2) \
+    INSTR(0x9B, "???", XXX, IMP, 5) \
+    INSTR(0x9C, "???", NOP, IMP, 5) \
+    INSTR(0x9D, "STA", STA, ABX, 5) \
+    INSTR(0x9E, "???", XXX, IMP, 5) \
+    INSTR(0x9F, "???", XXX, IMP, 5) \
+    INSTR(0xA0, "LDY", LDY, IMM, 2) \
+    INSTR(0xA1, "LDA", LDA, IZX, 6) \
+    INSTR(0xA2, "LDX", LDX, IMM, 2) \
+    INSTR(0xA3, "???", XXX, IMP, 6) \
+    INSTR(0xA4, "LDY", LDY, ZP0, 3) \
+    INSTR(0xA5, "LDA", LDA, ZP0, 3) \
+    INSTR(0xA6, "LDX", LDX, ZP0, 3) \
+    INSTR(0xA7, "???", XXX, IMP, 3) \
+    INSTR(0xA8, "TAY", TAY, IMP, 2) \
+    INSTR(0xA9, "LDA", LDA, IMM, 2) \
+    INSTR(0xAA, "TAX", TAX, IMP, 2) \
+    INSTR(0xAB, "???", XXX, IMP, 2) \
+    INSTR(0xAC, "LDY", LDY, ABS, 4) \
+    INSTR(0xAD, "LDA", LDA, ABS, 4) \
+    INSTR(0xAE, "LDX", LDX, ABS, 4) \
+    INSTR(0xAF, "???", XXX, IMP, 4) \
+    INSTR(0xB0, "BCS", BCS, REL, 2) \
+    INSTR(0xB1, "LDA", LDA, IZY, 5) \
+    INSTR(0xB2, "???", XXX, IMP, 2) \
+    INSTR(0xB3, "???", XXX, IMP, 5) \
+    INSTR(0xB4, "LDY", LDY, ZPX, 4) \
+    INSTR(0xB5, "LDA", LDA, ZPX, 4) \
+    INSTR(0xB6, "LDX", LDX, ZPY, 4) \
+    INSTR(0xB7, "???", XXX, IMP, 4) \
+    INSTR(0xB8, "CLV", CLV, IMP, 2) \
+    INSTR(0xB9, "LDA", LDA, ABY, 4) \
+    INSTR(0xBA, "TSX", TSX, IMP, 2) \
+    INSTR(0xBB, "???", XXX, IMP, 4) \
+    INSTR(0xBC, "LDY", LDY, ABX, 4) \
+    INSTR(0xBD, "LDA", LDA, ABX, 4) \
+    INSTR(0xBE, "LDX", LDX, ABY, 4) \
+    INSTR(0xBF, "???", XXX, IMP, 4) \
+    INSTR(0xC0, "CPY", CPY, IMM, 2) \
+    INSTR(0xC1, "CMP", CMP, IZX, 6) \
+    INSTR(0xC2, "???", NOP, IMP, 2) \
+    INSTR(0xC3, "???", XXX, IMP, 8) \
+    INSTR(0xC4, "CPY", CPY, ZP0, 3) \
+    INSTR(0xC5, "CMP", CMP, ZP0, 3) \
+    INSTR(0xC6, "DEC", DEC, ZP0, 5) \
+    INSTR(0xC7, "???", XXX, IMP, 5) \
+    INSTR(0xC8, "INY", INY, IMP, 2) \
+    INSTR(0xC9, "CMP", CMP, IMM, 2) \
+    INSTR(0xCA, "DEX", DEX, IMP, 2) \
+    INSTR(0xCB, "???", XXX, IMP, 2) \
+    INSTR(0xCC, "CPY", CPY, ABS, 4) \
+    INSTR(0xCD, "CMP", CMP, ABS, 4) \
+    INSTR(0xCE, "DEC", DEC, ABS, 6) \
+    INSTR(0xCF, "???", XXX, IMP, 6) \
+    INSTR(0xD0, "BNE", BNE, REL, 2) \
+    INSTR(0xD1, "CMP", CMP, IZY, 5) \
+    INSTR(0xD2, "???", XXX, IMP, 2) \
+    INSTR(0xD3, "???", XXX, IMP, 8) \
+    INSTR(0xD4, "???", NOP, IMP, 4) \
+    INSTR(0xD5, "CMP", CMP, ZPX, 4) \
+    INSTR(0xD6, "DEC", DEC, ZPX, 6) \
+    INSTR(0xD7, "???", XXX, IMP, 6) \
+    INSTR(0xD8, "CLD", CLD, IMP, 2) \
+    INSTR(0xD9, "CMP", CMP, ABY, 4) \
+    INSTR(0xDA, "NOP", NOP, IMP, 2) \
+    INSTR(0xDB, "???", XXX, IMP, 7) \
+    INSTR(0xDC, "???", NOP, IMP, 4) \
+    INSTR(0xDD, "CMP", CMP, ABX, 4) \
+    INSTR(0xDE, "DEC", DEC, ABX, 7) \
+    INSTR(0xDF, "???", XXX, IMP, 7) \
+    INSTR(0xE0, "CPX", CPX, IMM, 2) \
+    INSTR(0xE1, "SBC", SBC, IZX, 6) \
+    INSTR(0xE2, "???", NOP, IMP, 2) \
+    INSTR(0xE3, "???", XXX, IMP, 8) \
+    INSTR(0xE4, "CPX", CPX, ZP0, 3) \
+    INSTR(0xE5, "SBC", SBC, ZP0, 3) \
+    INSTR(0xE6, "INC", INC, ZP0, 5) \
+    INSTR(0xE7, "???", XXX, IMP, 5) \
+    INSTR(0xE8, "INX", INX, IMP, 2) \
+    INSTR(0xE9, "SBC", SBC, IMM, 2) \
+    INSTR(0xEA, "NOP", NOP, IMP, 2) \
+    INSTR(0xEB, "???", SBC, IMP, 2) \
+    INSTR(0xEC, "CPX", CPX, ABS, 4) \
+    INSTR(0xED, "SBC", SBC, ABS, 4) \
+    INSTR(0xEE, "INC", INC, ABS, 6) \
+    INSTR(0xEF, "???", XXX, IMP, 6) \
+    INSTR(0xF0, "BEQ", BEQ, REL, 2) \
+    INSTR(0xF1, "SBC", SBC, IZY, 5) \
+    INSTR(0xF2, "???", XXX, IMP, 2) \
+    INSTR(0xF3, "???", XXX, IMP, 8) \
+    INSTR(0xF4, "???", NOP, IMP, 4) \
+    INSTR(0xF5, "SBC", SBC, ZPX, 4) \
+    INSTR(0xF6, "INC", INC, ZPX, 6) \
+    INSTR(0xF7, "???", XXX, IMP, 6) \
+    INSTR(0xF8, "SED", SED, IMP, 2) \
+    INSTR(0xF9, "SBC", SBC, ABY, 4) \
+    INSTR(0xFA, "NOP", NOP, IMP, 2) \
+    INSTR(0xFB, "???", XXX, IMP, 7) \
+    INSTR(0xFC, "???", NOP, IMP, 4) \
+    INSTR(0xFD, "SBC", SBC, ABX, 4) \
+    INSTR(0xFE, "INC", INC, ABX, 7) \
+    INSTR(0xFF, "???", XXX, IMP, 7)
+
+/* Superinstructions - common pairs of instructions that the decoded
+ * instruction cache runs as one fused operation. Expanded with a 'PAIR' macro
+ * taking the opcode, operation, addressing mode and base clock cycles of the
+ * first instruction, then the same for the second one. They are checked
+ * against 'opcode_table' below */
+#define CPU6502_FUSED_PAIRS(PAIR) \
+    PAIR(0xCA, DEX, IMP, 2, 0xD0, BNE, REL, 2) \
+    PAIR(0x88, DEY, IMP, 2, 0xD0, BNE, REL, 2) \
+    PAIR(0xE8, INX, IMP, 2, 0xD0, BNE, REL, 2) \
+    PAIR(0xAD, LDA, ABS, 4, 0x8D, STA, ABS, 4) \
+    PAIR(0xE6, INC, ZP0, 5, 0xA5, LDA, ZP0, 3) \
+    PAIR(0xC9, CMP, IMM, 2, 0xF0, BEQ, REL, 2) \
+    PAIR(0xC9, CMP, IMM, 2, 0xD0, BNE, REL, 2)
+
+/* 6502 operations - status flags written (see 'cpu6502::flags'), whether an
+ * indexed read that crosses a page takes one more clock cycle, and whether the
+ * program counter can jump elsewhere. Expanded with an 'OP' macro */
+#define CPU6502_OPERATIONS(OP) \
+    OP(ADC, "NVZC", 1, 0) \
+    OP(AND, "NZ", 1, 0) \
+    OP(ASL, "NZC", 0, 0) \
+    OP(BCC, "", 0, 1) \
+    OP(BCS, "", 0, 1) \
+    OP(BEQ, "", 0, 1) \
+    OP(BIT, "NVZ", 0, 0) \
+    OP(BMI, "", 0, 1) \
+    OP(BNE, "", 0, 1) \
+    OP(BPL, "", 0, 1) \
+    OP(BRK, "IB", 0, 1) \
+    OP(BVC, "", 0, 1) \
+    OP(BVS, "", 0, 1) \
+    OP(CLC, "C", 0, 0) \
+    OP(CLD, "D", 0, 0) \
+    OP(CLI, "I", 0, 0) \
+    OP(CLV, "V", 0, 0) \
+    OP(CMP, "NZC", 1, 0) \
+    OP(CPX, "NZC", 0, 0) \
+    OP(CPY, "NZC", 0, 0) \
+    OP(DEC, "NZ", 0, 0) \
+    OP(DEX, "NZ", 0, 0) \
+    OP(DEY, "NZ", 0, 0) \
+    OP(EOR, "NZ", 1, 0) \
+    OP(INC, "NZ", 0, 0) \
+    OP(INX, "NZ", 0, 0) \
+    OP(INY, "NZ", 0, 0) \
+    OP(JMP, "", 0, 1) \
+    OP(JSR, "", 0, 1) \
+    OP(LDA, "NZ", 1, 0) \
+    OP(LDX, "NZ", 1, 0) \
+    OP(LDY, "NZ", 1, 0) \
+    OP(LSR, "NZC", 0, 0) \
+    OP(NOP, "", 0, 0) \
+    OP(ORA, "NZ", 1, 0) \
+    OP(PHA, "", 0, 0) \
+    OP(PHP, "BU", 0, 0) \
+    OP(PLA, "NZ", 0, 0) \
+    OP(PLP, "NVUBDIZC", 0, 0) \
+    OP(ROL, "NZC", 0, 0) \
+    OP(ROR, "NZC", 0, 0) \
+    OP(RTI, "NVUBDIZC", 0, 1) \
+    OP(RTS, "", 0, 1) \
+    OP(SBC, "NVZC", 1, 0) \
+    OP(SEC, "C", 0, 0) \
+    OP(SED, "D", 0, 0) \
+    OP(SEI, "I", 0, 0) \
+    OP(STA, "", 0, 0) \
+    OP(STX, "", 0, 0) \
+    OP(STY, "", 0, 0) \
+    OP(TAX, "NZ", 0, 0) \
+    OP(TAY, "NZ", 0, 0) \
+    OP(TSX, "NZ", 0, 0) \
+    OP(TXA, "NZ", 0, 0) \
+    OP(TXS, "", 0, 0) \
+    OP(TYA, "NZ", 0, 0) \
+    OP(XXX, "", 0, 0)
+
+/*=============================================================================
+ * OPCODE METADATA
+ *===========================================================================*/
+enum class addressing : uint8_t {
+    IMP, IMM, ZP0, ZPX, ZPY, REL, ABS, ABX, ABY, IND, IZX, IZY
+};
+
+#define OPERATION_ENUM(operate, flags, page_cross, control_flow) operate,
+enum class operation : uint8_t {
+    CPU6502_OPERATIONS(OPERATION_ENUM)
+};
+#undef OPERATION_ENUM
+
+/* Status register bits named by a string of flag letters, e.g. "NZC" */
+constexpr uint8_t status_bits(const char *letters) {
+    return !*letters ? 0 :
+           (*letters == 'C' ? cpu6502::C : *letters == 'Z' ? cpu6502::Z :
+            *letters == 'I' ? cpu6502::I : *letters == 'D' ? cpu6502::D :
+            *letters == 'B' ? cpu6502::B : *letters == 'U' ? cpu6502::U :
+            *letters == 'V' ? cpu6502::V : cpu6502::N) | status_bits(letters + 1);
+}
+
+struct OperationInfo {
+    uint8_t flags;                      // Status flags written
+    bool    page_cross;                 // Extra cycle for indexed page crossing
+    bool    control_flow;               // Can jump, branch or return
+};
+
+#define OPERATION_INFO(operate, flags, page_cross, control_flow) \
+    { status_bits(flags), page_cross, control_flow },
+constexpr OperationInfo operation_table[] = {
+    CPU6502_OPERATIONS(OPERATION_INFO)
+};
+#undef OPERATION_INFO
+
+/* Compact description of an opcode, shared by the interpreter, the decoded
+ * instruction cache, the block backend and the disassembler */
+struct OpcodeInfo {
+    const char *mnemonic;
+    addressing  mode;
+    operation   op;
+    uint8_t     cycles;                 // Base clock cycles
+    uint8_t     page_cross_cycles;      // Added when an indexed read crosses a page
+    uint8_t     length;                 // Opcode and operand bytes
+    uint8_t     flags;                  // Status flags written
+    bool        control_flow;           // Can jump, branch or return
+};
+
+constexpr uint8_t opcode_length(addressing mode) {
+    return mode == addressing::IMP ? 1 :
+           (mode == addressing::ABS || mode == addressing::ABX ||
+            mode == addressing::ABY || mode == addressing::IND) ? 3 : 2;
+}
+
+constexpr uint8_t page_cross_cycles(addressing mode, operation op) {
+    return (operation_table[(size_t)op].page_cross &&
+            (mode == addressing::ABX || mode == addressing::ABY ||
+             mode == addressing::IZY)) ? 1 : 0;
+}
+
+#define OPCODE_INFO(opcode, mnemonic, operate, addr_mode, cycles) \
+    { mnemonic, addressing::addr_mode, operation::operate, cycles, \
+      page_cross_cycles(addressing::addr_mode, operation::operate), \
+      opcode_length(addressing::addr_mode), \
+      operation_table[(size_t)operation::operate].flags, \
+      operation_table[(size_t)operation::operate].control_flow },
+constexpr OpcodeInfo opcode_table[256] = {
+    CPU6502_INSTRUCTIONS(OPCODE_INFO)
+};
+#undef OPCODE_INFO
+
+struct FusedPairInfo {
+    uint8_t     first;                  // Opcode of the first instruction
+    uint8_t     second;                 // Opcode of the second one
+    const char *name;
+};
+
+#define FUSED_PAIR_INFO(opcode_1, operate_1, addr_mode_1, cycles_1, \
+                        opcode_2, operate_2, addr_mode_2, cycles_2) \
+    { opcode_1, opcode_2, #operate_1 " " #operate_2 },
+constexpr FusedPairInfo fused_pairs[] = {
+    CPU6502_FUSED_PAIRS(FUSED_PAIR_INFO)
+};
+#undef FUSED_PAIR_INFO
+
+constexpr size_t NUM_FUSED_PAIRS = sizeof(fused_pairs) / sizeof(fused_pairs[0]);
+
+// Fused handlers are built from the operations, addressing modes and cycles
+// listed in 'CPU6502_FUSED_PAIRS', which have to be those of the opcodes
+#define FUSED_PAIR_CHECK(opcode_1, operate_1, addr_mode_1, cycles_1, \
+                         opcode_2, operate_2, addr_mode_2, cycles_2) \
+    static_assert(opcode_table[opcode_1].op == operation::operate_1 && \
+                  opcode_table[opcode_1].mode == addressing::addr_mode_1 && \
+                  opcode_table[opcode_1].cycles == cycles_1 && \
+                  opcode_table[opcode_2].op == operation::operate_2 && \
+                  opcode_table[opcode_2].mode == addressing::addr_mode_2 && \
+                  opcode_table[opcode_2].cycles == cycles_2, \
+                  "Fused pair " #operate_1 " " #operate_2 " does not match 'opcode_table'");
+CPU6502_FUSED_PAIRS(FUSED_PAIR_CHECK)
+#undef FUSED_PAIR_CHECK
+
+#endif
@@ -1,6 +1,12 @@
 #include <iostream>
 #include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <algorithm>
 #include "emulator.h"
+#include "headless.h"
 
 void display_help() {
     std::cout << "\n*=================================================="
@@ -9,8 +15,33 @@ void display_help() {
               << "\n*==================================================";
     std::cout << "\n> Run \"./nes <filename.nes> ..\" to start NES game"
               << "\n> Optional flags:"
-              << "\n>   --debug | -D : Show debug window"
-              << "\n>   --help  | -H : Display this help message\n\n";
+              << "\n>   --debug            | -D     : Show debug window"
+              << "\n>   --blocks           | -T     : Run ROM code as threaded blocks"
+              << "\n>   --scanline         | -S     : Draw whole scan lines at once"
+              << "\n>   --frameskip <N>    | -F <N> : Render only every Nth frame"
+              << "\n>   --vsync            | -V     : Emulate one frame per display refresh"
+              << "\n>   --runahead <N>     | -A <N> : Show video N frames ahead to hide"
+              << "\n>                                 input lag"
+              << "\n>   --benchmark <N>    | -B <N> : Run N frames headless, report speed"
+              << "\n>   --differential <N> | -X <N> : Check blocks against interpreter"
+              << "\n>                                 for N frames"
+              << "\n>   --help             | -H     : Display this help message\n\n";
+}
+
+/* Parses the count following flag 'argv[i]' into 'n'. False if it is missing
+ * or is not a whole number that fits */
+bool parse_count(int argc, char *argv[], int i, uint32_t &n) {
+    if (i + 1 >= argc) return false;
+
+    const char *str = argv[i + 1];
+    char *end = nullptr;
+    errno = 0;
+    unsigned long value = strtoul(str, &end, 10);
+    if (!isdigit((unsigned char)str[0]) || *end != '\0' || errno == ERANGE ||
+        value > UINT32_MAX) return false;
+
+    n = value;
+    return true;
 }
 
 int main(int argc, char *argv[]) {
@@ -24,16 +55,58 @@ int main(int argc, char *argv[]) {
         return EXIT_SUCCESS;
     }
     else {
+        cpu6502::backend backend = cpu6502::INTERPRETER;
+        ppu2C02::renderer renderer = ppu2C02::DOT;
+        uint32_t frameskip = 1;
+        bool vsync = false;
+        uint32_t runahead = 0;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--blocks") == 0 || strcmp(argv[i], "-T") == 0)
+                backend = cpu6502::BLOCKS;
+            else if (strcmp(argv[i], "--scanline") == 0 || strcmp(argv[i], "-S") == 0)
+                renderer = ppu2C02::SCANLINE;
+            else if (strcmp(argv[i], "--frameskip") == 0 || strcmp(argv[i], "-F") == 0) {
+                if (!parse_count(argc, argv, i, frameskip)) { display_help(); return EXIT_FAILURE; }
+                frameskip = std::max<uint32_t>(frameskip, 1);
+            }
+            else if (strcmp(argv[i], "--vsync") == 0 || strcmp(argv[i], "-V") == 0)
+                vsync = true;
+            else if (strcmp(argv[i], "--runahead") == 0 || strcmp(argv[i], "-A") == 0) {
+                if (!parse_count(argc, argv, i, runahead)) { display_help(); return EXIT_FAILURE; }
+            }
+        }
+
         for (int i = 2; i < argc; i++) {
             if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-H") == 0) {
                 display_help();
                 return EXIT_SUCCESS;
             }
             else if (strcmp(argv[i], "--debug") == 0 || strcmp(argv[i], "-D") == 0) {
-                Emulator nes(Emulator::DEBUG_MODE, argv[1]);
+                Emulator nes(Emulator::DEBUG_MODE, argv[1], backend, renderer, frameskip, vsync,
+                             runahead);
                 nes.begin();
                 return EXIT_SUCCESS;
             }
+            else if (strcmp(argv[i], "--benchmark") == 0 || strcmp(argv[i], "-B") == 0) {
+                uint32_t num_frames = 0;
+                if (!parse_count(argc, argv, i, num_frames)) { display_help(); return EXIT_FAILURE; }
+                Headless nes(argv[1], backend, renderer);
+                nes.set_frameskip(frameskip);
+                nes.set_runahead(runahead);
+                nes.benchmark(num_frames);
+                return EXIT_SUCCESS;
+            }
+            else if (strcmp(argv[i], "--differential") == 0 || strcmp(argv[i], "-X") == 0) {
+                uint32_t num_frames = 0;
+                if (!parse_count(argc, argv, i, num_frames)) { display_help(); return EXIT_FAILURE; }
+                bool matching = Headless::differential(argv[1], num_frames, renderer);
+                return matching ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
         }
+
+        Emulator nes(Emulator::NORMAL_MODE, argv[1], backend, renderer, frameskip, vsync,
+                     runahead);
+        nes.begin();
+        return EXIT_SUCCESS;
     }
 }
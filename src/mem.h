@@ -34,6 +34,9 @@
 #define CONTROLLER_ADDR_LOWER 0x4016
 #define CONTROLLER_ADDR_UPPER 0x4017
 
+#define CARTRIDGE_ADDR_LOWER 0x4020
+#define CARTRIDGE_PAGES_LOWER 0x4100
+
 /* OAM */
 #define OAM_ADDR 0x4014
 
@@ -1,69 +1,69 @@
 #include "ppu.h"
 
 /* All of the colors that the NES can display */
-const SDL_Color ppu2C02::palettes[0x40] = {
-    SDL_Color { 84, 84, 84, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 30, 116, SDL_ALPHA_OPAQUE },
-    SDL_Color { 8, 16, 144, SDL_ALPHA_OPAQUE },
-    SDL_Color { 48, 0, 136, SDL_ALPHA_OPAQUE },
-    SDL_Color { 68, 0, 100, SDL_ALPHA_OPAQUE },
-    SDL_Color { 92, 0, 48, SDL_ALPHA_OPAQUE },
-    SDL_Color { 84, 4, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 60, 24, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 32, 42, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 8, 58, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 64, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 60, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 50, 60, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 0, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 0, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 0, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 152, 150, 152, SDL_ALPHA_OPAQUE },
-    SDL_Color { 8, 76, 196, SDL_ALPHA_OPAQUE },
-    SDL_Color { 48, 50, 236, SDL_ALPHA_OPAQUE },
-    SDL_Color { 92, 30, 228, SDL_ALPHA_OPAQUE },
-    SDL_Color { 136, 20, 176, SDL_ALPHA_OPAQUE },
-    SDL_Color { 160, 20, 100, SDL_ALPHA_OPAQUE },
-    SDL_Color { 152, 34, 32, SDL_ALPHA_OPAQUE },
-    SDL_Color { 120, 60, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 84, 90, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 40, 114, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 8, 124, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 118, 40, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 102, 120, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 0, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 0, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 0, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 236, 238, 236, SDL_ALPHA_OPAQUE },
-    SDL_Color { 76, 154, 236, SDL_ALPHA_OPAQUE },
-    SDL_Color { 120, 124, 236, SDL_ALPHA_OPAQUE },
-    SDL_Color { 176, 98, 236, SDL_ALPHA_OPAQUE },
-    SDL_Color { 228, 84, 236, SDL_ALPHA_OPAQUE },
-    SDL_Color { 236, 88, 180, SDL_ALPHA_OPAQUE },
-    SDL_Color { 236, 106, 100, SDL_ALPHA_OPAQUE },
-    SDL_Color { 212, 136, 32, SDL_ALPHA_OPAQUE },
-    SDL_Color { 160, 170, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 116, 196, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 76, 208, 32, SDL_ALPHA_OPAQUE },
-    SDL_Color { 56, 204, 108, SDL_ALPHA_OPAQUE },
-    SDL_Color { 56, 180, 204, SDL_ALPHA_OPAQUE },
-    SDL_Color { 60, 60, 60, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 0, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 0, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 236, 238, 236, SDL_ALPHA_OPAQUE },
-    SDL_Color { 168, 204, 236, SDL_ALPHA_OPAQUE },
-    SDL_Color { 188, 188, 236, SDL_ALPHA_OPAQUE },
-    SDL_Color { 212, 178, 236, SDL_ALPHA_OPAQUE },
-    SDL_Color { 236, 174, 236, SDL_ALPHA_OPAQUE },
-    SDL_Color { 236, 174, 212, SDL_ALPHA_OPAQUE },
-    SDL_Color { 236, 180, 176, SDL_ALPHA_OPAQUE },
-    SDL_Color { 228, 196, 144, SDL_ALPHA_OPAQUE },
-    SDL_Color { 204, 210, 120, SDL_ALPHA_OPAQUE },
-    SDL_Color { 180, 222, 120, SDL_ALPHA_OPAQUE },
-    SDL_Color { 168, 226, 144, SDL_ALPHA_OPAQUE },
-    SDL_Color { 152, 226, 180, SDL_ALPHA_OPAQUE },
-    SDL_Color { 160, 214, 228, SDL_ALPHA_OPAQUE },
-    SDL_Color { 160, 162, 160, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 0, 0, SDL_ALPHA_OPAQUE },
-    SDL_Color { 0, 0, 0, SDL_ALPHA_OPAQUE }
+const ppu2C02::Color ppu2C02::palettes[0x40] = {
+    Color { 84, 84, 84, ALPHA_OPAQUE },
+    Color { 0, 30, 116, ALPHA_OPAQUE },
+    Color { 8, 16, 144, ALPHA_OPAQUE },
+    Color { 48, 0, 136, ALPHA_OPAQUE },
+    Color { 68, 0, 100, ALPHA_OPAQUE },
+    Color { 92, 0, 48, ALPHA_OPAQUE },
+    Color { 84, 4, 0, ALPHA_OPAQUE },
+    Color { 60, 24, 0, ALPHA_OPAQUE },
+    Color { 32, 42, 0, ALPHA_OPAQUE },
+    Color { 8, 58, 0, ALPHA_OPAQUE },
+    Color { 0, 64, 0, ALPHA_OPAQUE },
+    Color { 0, 60, 0, ALPHA_OPAQUE },
+    Color { 0, 50, 60, ALPHA_OPAQUE },
+    Color { 0, 0, 0, ALPHA_OPAQUE },
+    Color { 0, 0, 0, ALPHA_OPAQUE },
+    Color { 0, 0, 0, ALPHA_OPAQUE },
+    Color { 152, 150, 152, ALPHA_OPAQUE },
+    Color { 8, 76, 196, ALPHA_OPAQUE },
+    Color { 48, 50, 236, ALPHA_OPAQUE },
+    Color { 92, 30, 228, ALPHA_OPAQUE },
+    Color { 136, 20, 176, ALPHA_OPAQUE },
+    Color { 160, 20, 100, ALPHA_OPAQUE },
+    Color { 152, 34, 32, ALPHA_OPAQUE },
+    Color { 120, 60, 0, ALPHA_OPAQUE },
+    Color { 84, 90, 0, ALPHA_OPAQUE },
+    Color { 40, 114, 0, ALPHA_OPAQUE },
+    Color { 8, 124, 0, ALPHA_OPAQUE },
+    Color { 0, 118, 40, ALPHA_OPAQUE },
+    Color { 0, 102, 120, ALPHA_OPAQUE },
+    Color { 0, 0, 0, ALPHA_OPAQUE },
+    Color { 0, 0, 0, ALPHA_OPAQUE },
+    Color { 0, 0, 0, ALPHA_OPAQUE },
+    Color { 236, 238, 236, ALPHA_OPAQUE },
+    Color { 76, 154, 236, ALPHA_OPAQUE },
+    Color { 120, 124, 236, ALPHA_OPAQUE },
+    Color { 176, 98, 236, ALPHA_OPAQUE },
+    Color { 228, 84, 236, ALPHA_OPAQUE },
+    Color { 236, 88, 180, ALPHA_OPAQUE },
+    Color { 236, 106, 100, ALPHA_OPAQUE },
+    Color { 212, 136, 32, ALPHA_OPAQUE },
+    Color { 160, 170, 0, ALPHA_OPAQUE },
+    Color { 116, 196, 0, ALPHA_OPAQUE },
+    Color { 76, 208, 32, ALPHA_OPAQUE },
+    Color { 56, 204, 108, ALPHA_OPAQUE },
+    Color { 56, 180, 204, ALPHA_OPAQUE },
+    Color { 60, 60, 60, ALPHA_OPAQUE },
+    Color { 0, 0, 0, ALPHA_OPAQUE },
+    Color { 0, 0, 0, ALPHA_OPAQUE },
+    Color { 236, 238, 236, ALPHA_OPAQUE },
+    Color { 168, 204, 236, ALPHA_OPAQUE },
+    Color { 188, 188, 236, ALPHA_OPAQUE },
+    Color { 212, 178, 236, ALPHA_OPAQUE },
+    Color { 236, 174, 236, ALPHA_OPAQUE },
+    Color { 236, 174, 212, ALPHA_OPAQUE },
+    Color { 236, 180, 176, ALPHA_OPAQUE },
+    Color { 228, 196, 144, ALPHA_OPAQUE },
+    Color { 204, 210, 120, ALPHA_OPAQUE },
+    Color { 180, 222, 120, ALPHA_OPAQUE },
+    Color { 168, 226, 144, ALPHA_OPAQUE },
+    Color { 152, 226, 180, ALPHA_OPAQUE },
+    Color { 160, 214, 228, ALPHA_OPAQUE },
+    Color { 160, 162, 160, ALPHA_OPAQUE },
+    Color { 0, 0, 0, ALPHA_OPAQUE },
+    Color { 0, 0, 0, ALPHA_OPAQUE }
 };
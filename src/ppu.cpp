@@ -2,18 +2,123 @@
 // all without this resource. Thanks so much :)
 // https://www.youtube.com/watch?v=cksywUTZxlY&ab_channel=javidx9
 
+#include <algorithm>
 #include "ppu.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#define PPU_X86_SIMD
+#include <immintrin.h>
+
+/* Indexed frame to RGBA, 8 pixels at a time with AVX2 gathers. Returns the
+ * number of pixels converted */
+__attribute__((target("avx2")))
+static size_t expand_pixels_avx2(const uint8_t *indexed_frame, uint8_t *rgba_pixels,
+                                 size_t num_pixels, const uint32_t *colors) {
+    const __m256i index_mask = _mm256_set1_epi32(0x3F);
+    size_t i = 0;
+
+    for (; i + 8 <= num_pixels; i += 8) {
+        __m128i indices = _mm_loadl_epi64((const __m128i *)&indexed_frame[i]);
+        __m256i idx = _mm256_and_si256(_mm256_cvtepu8_epi32(indices), index_mask);
+        __m256i rgba = _mm256_i32gather_epi32((const int *)colors, idx, 4);
+        _mm256_storeu_si256((__m256i *)&rgba_pixels[i << 2], rgba);
+    }
+    return i;
+}
+
+/* Indexed frame to RGBA, 16 pixels at a time. Each color byte comes from 4
+ * shuffles of 16-entry tables. Returns the number of pixels converted */
+__attribute__((target("ssse3")))
+static size_t expand_pixels_ssse3(const uint8_t *indexed_frame, uint8_t *rgba_pixels,
+                                  size_t num_pixels, const uint32_t *colors) {
+    // Each color channel split into 4 tables of 16 entries
+    __m128i channels[4][4];
+    for (uint8_t c = 0; c < 4; c++) {
+        for (uint8_t t = 0; t < 4; t++) {
+            uint8_t table[16];
+            for (uint8_t e = 0; e < 16; e++) table[e] = colors[(t << 4) + e] >> (c << 3);
+            channels[c][t] = _mm_loadu_si128((const __m128i *)table);
+        }
+    }
+
+    const __m128i low_mask = _mm_set1_epi8(0x0F);
+    const __m128i table_mask = _mm_set1_epi8(0x03);
+    size_t i = 0;
+
+    for (; i + 16 <= num_pixels; i += 16) {
+        __m128i idx = _mm_loadu_si128((const __m128i *)&indexed_frame[i]);
+        __m128i lo = _mm_and_si128(idx, low_mask);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(idx, 4), table_mask);
+
+        __m128i bytes[4];
+        for (uint8_t c = 0; c < 4; c++) {
+            bytes[c] = _mm_setzero_si128();
+            for (uint8_t t = 0; t < 4; t++) {
+                __m128i in_table = _mm_cmpeq_epi8(hi, _mm_set1_epi8(t));
+                bytes[c] = _mm_or_si128(bytes[c], _mm_and_si128(in_table,
+                                        _mm_shuffle_epi8(channels[c][t], lo)));
+            }
+        }
+
+        // Interleave R, G, B, A into RGBA pixels
+        __m128i rg_lo = _mm_unpacklo_epi8(bytes[0], bytes[1]);
+        __m128i rg_hi = _mm_unpackhi_epi8(bytes[0], bytes[1]);
+        __m128i ba_lo = _mm_unpacklo_epi8(bytes[2], bytes[3]);
+        __m128i ba_hi = _mm_unpackhi_epi8(bytes[2], bytes[3]);
+        __m128i *out = (__m128i *)&rgba_pixels[i << 2];
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(rg_lo, ba_lo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(rg_lo, ba_lo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(rg_hi, ba_hi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(rg_hi, ba_hi));
+    }
+    return i;
+}
+#endif
+
 /*=============================================================================
  * PPU methods
  *===========================================================================*/
-ppu2C02::ppu2C02() : _scan_line(0), _cycle(0), _frame_completed(false) {}
+ppu2C02::ppu2C02() :
+    bus(nullptr), _sprite_count(0), _tiles_bank_serial(0), _scan_line(0), _cycle(0),
+    _frame_completed(false), _renderer(DOT), _nmi(false)
+{
+    _invalidate_tiles();
+    std::memset(oam, 0x00, sizeof(oam));
+    std::memset(ppu_name_table, 0x00, sizeof(ppu_name_table));
+    for (uint8_t i = 0; i < 4; i++) _nametables[i] = ppu_name_table[i >> 1];
+    std::memset(ppu_palette_table, 0x00, sizeof(ppu_palette_table));
+    std::memset(sprite_scanline, 0x00, sizeof(sprite_scanline));
+    std::memset(_sprite_shifter_pattern_lo, 0x00, sizeof(_sprite_shifter_pattern_lo));
+    std::memset(_sprite_shifter_pattern_hi, 0x00, sizeof(_sprite_shifter_pattern_hi));
+    status_register.reg = 0x00;
+    mask_register.reg = 0x00;
+    control_register.reg = 0x00;
+    _frame_buffer.resize(NES_WINDOW_WIDTH * NES_WINDOW_HEIGHT, 0x0F);
+    _refresh_palette_cache();
+}
 
 ppu2C02::~ppu2C02() {}
 
 void ppu2C02::connect_to_cartridge(const std::shared_ptr<Cartridge>& _cartridge) {
     assert(_cartridge);
     cartridge = _cartridge;
+    _invalidate_tiles();
+    map_nametables();
+}
+
+/* Points the 4 nametables at VRAM pages according to the cartridge mirroring.
+ * The bus calls it again whenever the mapper switches banks or mirroring */
+void ppu2C02::map_nametables() {
+    static const uint8_t pages[5][4] = {
+        { 0, 0, 1, 1 },     // HORIZONTAL
+        { 0, 1, 0, 1 },     // VERTICAL
+        { 0, 0, 0, 0 },     // ONESCREEN_LO
+        { 1, 1, 1, 1 },     // ONESCREEN_HI
+        { 0, 1, 2, 3 }      // FOUR_SCREEN
+    };
+
+    Cartridge::MIRROR mirror = cartridge->get_mirror();
+    for (uint8_t i = 0; i < 4; i++) _nametables[i] = ppu_name_table[pages[mirror][i]];
 }
 
 void ppu2C02::connect_to_bus(Bus *b) { assert(b); bus = b; }
@@ -21,61 +126,144 @@ void ppu2C02::connect_to_bus(Bus *b) { assert(b); bus = b; }
 /*=============================================================================
  * GUI HELPERS
  *===========================================================================*/
-/* GUI helpers - set NES video texture for video rendering */
-void ppu2C02::set_video_texture(std::shared_ptr<Texture> &video_text) {
-    assert(video_text);
-    _video_text = video_text;
+/* GUI helpers - NES video output of the last rendered dots, as system
+ * palette indices (256x240 bytes) */
+const uint8_t *ppu2C02::get_indexed_frame() { return _frame_buffer.data(); }
+
+/* GUI helpers - converts an indexed frame to RGBA pixels in one pass, with
+ * the widest vector instructions the CPU supports */
+void ppu2C02::expand_frame(const uint8_t *indexed_frame, uint8_t *rgba_pixels) {
+    assert(indexed_frame && rgba_pixels);
+    const size_t num_pixels = NES_WINDOW_WIDTH * NES_WINDOW_HEIGHT;
+    size_t i = 0;
+
+    uint32_t colors[0x40];
+    std::memcpy(colors, palettes, sizeof(colors));
+
+#ifdef PPU_X86_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        i = expand_pixels_avx2(indexed_frame, rgba_pixels, num_pixels, colors);
+    else if (__builtin_cpu_supports("ssse3"))
+        i = expand_pixels_ssse3(indexed_frame, rgba_pixels, num_pixels, colors);
+#endif
+
+    for (; i < num_pixels; i++)
+        std::memcpy(&rgba_pixels[i << 2], &colors[indexed_frame[i] & 0x3F], sizeof(uint32_t));
 }
 
-/* GUI helpers - update palette selection texture */
-void ppu2C02::get_palettes_texture(std::shared_ptr<Texture> &palettes_text,
-                                                uint8_t palette) {
+/* GUI helpers - update palette selection pixels (4x1) */
+void ppu2C02::get_palettes_texture(uint8_t *palettes_pixels, uint8_t palette) {
+    assert(palettes_pixels);
     for (uint8_t i = 0; i < 4; i++) {
-        SDL_Color color = get_palette_from_offsets(i, palette);
-        palettes_text->update_texture(i, color.r, color.g, color.b);
+        const Color &color = get_palette_from_offsets(i, palette);
+        std::memcpy(&palettes_pixels[i << 2], &color, sizeof(Color));
     }
 }
 
 /* GUI helpers - get palette from offset */
-const SDL_Color &ppu2C02::get_palette_from_offsets(uint8_t idx, uint8_t palette) {
-    return palettes[
-        read_from_ppu_bus(PALETTE_ADDR_LOWER + (palette << 2) + idx, false) & 0x3F
-    ];
+const ppu2C02::Color &ppu2C02::get_palette_from_offsets(uint8_t idx, uint8_t palette) {
+    return _palette_cache[((palette << 2) + idx) & 0x1F];
+}
+
+/* Resolves every palette memory entry the same way as 'read_from_ppu_bus()'
+ * (mirrors and grayscale). Color emphasis bits are not emulated */
+void ppu2C02::_refresh_palette_cache() {
+    for (uint8_t i = 0; i < 32; i++) {
+        uint8_t addr = ((i & 0x13) == 0x10) ? (i & 0x0F) : i;
+        _palette_indices[i] = ppu_palette_table[addr] & (mask_register.grayscale ? 0x30 : 0x3F);
+        _palette_cache[i] = palettes[_palette_indices[i]];
+    }
+    _palette_serial++;
 }
 
-/* GUI helpers - update pattern memory texture */
-void ppu2C02::get_chr_rom_texture(std::shared_ptr<Texture> &chr_rom_text,
-                                                uint8_t idx, uint8_t palette) {
+uint32_t ppu2C02::get_palette_serial() { return _palette_serial; }
+
+uint32_t ppu2C02::get_chr_serial() {
+    if (cartridge && cartridge->get_bank_serial() != _tiles_bank_serial) _invalidate_tiles();
+    return _chr_serial;
+}
+
+/* GUI helpers - update pattern memory pixels (128x128) */
+void ppu2C02::get_chr_rom_texture(uint8_t *chr_rom_pixels, uint8_t idx, uint8_t palette) {
+    assert(chr_rom_pixels);
     // Iterate through each tile
     for (uint16_t row_tile = 0; row_tile < 16; row_tile++) {
         for (uint16_t col_tile = 0; col_tile < 16; col_tile++) {
-
-            // Get byte offset
-            uint16_t b_offset = (((row_tile << 4) + col_tile) << 4);
+            const Tile &tile = _tile((idx << 8) | (row_tile << 4) | col_tile);
 
             // Begin iteration through each pixel in tile
             for (uint8_t row_px = 0; row_px < 8; row_px++) {
-                uint8_t lsb = read_from_ppu_bus(idx * 0x1000 + b_offset + row_px, false);
-                uint8_t msb = read_from_ppu_bus(idx * 0x1000 + b_offset + row_px + 8, false);
-
                 for (uint8_t col_px = 0; col_px < 8; col_px++) {
-                    uint8_t px = ((msb & 0x01) << 1) | (lsb & 0x01);
-
                     // Get palette color
-                    SDL_Color color = get_palette_from_offsets(px, palette);
+                    const Color &color =
+                        get_palette_from_offsets(tile.pixels[row_px][col_px], palette);
 
-                    // Update passed-in CHR ROM texture
-                    uint16_t x = (col_tile << 3) + 7 - col_px;
+                    // Update passed-in CHR ROM pixels
+                    uint16_t x = (col_tile << 3) + col_px;
                     uint16_t y = (row_tile << 3) + row_px;
-                    chr_rom_text->update_texture((y << 7) + x, color.r, color.g, color.b);
-
-                    lsb >>= 1; msb >>= 1;
+                    std::memcpy(&chr_rom_pixels[((y << 7) + x) << 2], &color, sizeof(Color));
                 }
             }   // End pixel iteration
         }
     }   // End tile iteration
 }
 
+/*=============================================================================
+ * CHR TILE CACHE
+ *===========================================================================*/
+static uint8_t flip_byte(uint8_t b) {
+    b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+    b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+    b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
+    return b;
+}
+
+void ppu2C02::_invalidate_tiles() {
+    std::memset(_tile_valid, false, sizeof(_tile_valid));
+    if (cartridge) _tiles_bank_serial = cartridge->get_bank_serial();
+    _chr_serial++;
+}
+
+/* Tile 'idx' of the pattern tables (0x000 - 0x1FF), decoded on first use */
+const ppu2C02::Tile &ppu2C02::_tile(uint16_t idx) {
+    assert(idx < 512);
+    if (cartridge->get_bank_serial() != _tiles_bank_serial) _invalidate_tiles();
+
+    Tile &tile = _tiles[idx];
+    if (_tile_valid[idx]) return tile;
+
+    for (uint8_t row = 0; row < 8; row++) {
+        uint8_t lsb = read_from_ppu_bus((idx << 4) + row, false);
+        uint8_t msb = read_from_ppu_bus((idx << 4) + row + 8, false);
+
+        tile.planes[0][row] = lsb;
+        tile.planes[1][row] = msb;
+        tile.flipped[0][row] = flip_byte(lsb);
+        tile.flipped[1][row] = flip_byte(msb);
+
+        for (uint8_t col = 0; col < 8; col++)
+            tile.pixels[row][col] = (((msb >> (7 - col)) & 0x01) << 1) |
+                                    ((lsb >> (7 - col)) & 0x01);
+    }
+
+    _tile_valid[idx] = true;
+    return tile;
+}
+
+/* Pattern table byte at 'addr' through the tile cache, horizontally flipped
+ * if requested. Addresses outside of the pattern tables (which sprite fetches
+ * on the pre-render line can produce) go to the PPU bus */
+uint8_t ppu2C02::_read_pattern(uint16_t addr, bool flipped) {
+    addr &= 0x3FFF;
+    if (addr > PATTERN_ADDR_UPPER) {
+        uint8_t data = read_from_ppu_bus(addr, false);
+        return flipped ? flip_byte(data) : data;
+    }
+
+    const Tile &tile = _tile(addr >> 4);
+    return (flipped ? tile.flipped : tile.planes)[(addr >> 3) & 0x01][addr & 0x07];
+}
+
 /*=============================================================================
  * PPU BG RENDERING HELPERS
  *===========================================================================*/
@@ -172,8 +360,27 @@ void ppu2C02::_render_bg() {
 
     if ((_cycle >= 2 && _cycle < 258) || (_cycle >= 321 && _cycle < 338)) {
         _update_shifters();
+        _fetch_bg_tile();
+    }
 
-        switch ((_cycle - 1) % 8) {
+    if (_cycle == 256) _increment_scroll_y();
+    if (_cycle == 257) {
+        _load_bg_shifters();
+        _transfer_address_x();
+    }
+
+    if (_cycle == 338 || _cycle == 340) {
+        _bg_next_tile_id = read_from_ppu_bus((0x2000 | (vram_addr.reg & 0x0FFF)), false);
+    }
+
+    if (_scan_line == -1 && _cycle >= 280 && _cycle < 305) {
+        _transfer_address_y();
+    }
+}
+
+/* Background tile fetches, one step every other dot of an 8 dots cycle */
+void ppu2C02::_fetch_bg_tile() {
+    switch ((_cycle - 1) % 8) {
         case 0:
             _load_bg_shifters();
             _bg_next_tile_id =
@@ -192,66 +399,63 @@ void ppu2C02::_render_bg() {
             break;
         case 4:
             _bg_next_tile_lsb =
-                read_from_ppu_bus(((control_register.pattern_background << 12)
-                                + ((uint16_t)_bg_next_tile_id << 4)
-                                + (vram_addr.fine_y) + 0), false);
+                _read_pattern(((control_register.pattern_background << 12)
+                            + ((uint16_t)_bg_next_tile_id << 4)
+                            + (vram_addr.fine_y) + 0), false);
             break;
         case 6:
             _bg_next_tile_msb =
-                read_from_ppu_bus(((control_register.pattern_background << 12)
-                                + ((uint16_t)_bg_next_tile_id << 4)
-                                + (vram_addr.fine_y) + 8), false);
+                _read_pattern(((control_register.pattern_background << 12)
+                            + ((uint16_t)_bg_next_tile_id << 4)
+                            + (vram_addr.fine_y) + 8), false);
             break;
         case 7:
             _increment_scroll_x();
             break;
-        }
-    }
-
-    if (_cycle == 256) _increment_scroll_y();
-    if (_cycle == 257) {
-        _load_bg_shifters();
-        _transfer_address_x();
     }
+}
 
-    if (_cycle == 338 || _cycle == 340) {
-        _bg_next_tile_id = read_from_ppu_bus((0x2000 | (vram_addr.reg & 0x0FFF)), false);
-    }
+/* OAM write, through $2004 or DMA */
+void ppu2C02::write_oam(uint8_t addr, uint8_t data) {
+    if (oam_ptr[addr] == data) return;
+    oam_ptr[addr] = data;
+    _sprite_lines_valid = false;
+}
 
-    if (_scan_line == -1 && _cycle >= 280 && _cycle < 305) {
-        _transfer_address_y();
+/* Buckets the OAM entries by the scanlines they are evaluated on, keeping the
+ * first 8 of each line like the sprite evaluation does */
+void ppu2C02::_build_sprite_lines() {
+    std::memset(_sprite_lines, 0x00, sizeof(_sprite_lines));
+    _sprite_lines_size = control_register.sprite_size;
+    uint8_t sprite_size = _sprite_lines_size ? 16 : 8;
+
+    for (uint8_t i = 0; i < 64; i++) {
+        for (uint16_t line = oam[i].y; line < oam[i].y + sprite_size && line < 240; line++) {
+            SpriteLine &sprites = _sprite_lines[line];
+            if (sprites.count < 8) sprites.entries[sprites.count++] = i;
+        }
     }
+    _sprite_lines_valid = true;
 }
 
 /* Foreground rendering */
 void ppu2C02::_render_fg() {
     if (_cycle == 257 && _scan_line >= 0) {
-        _sprite_count = 0;
+        if (!_sprite_lines_valid || _sprite_lines_size != control_register.sprite_size)
+            _build_sprite_lines();
 
         // Reset sprite buffer
         std::memset(sprite_scanline, 0xFF, 8 * sizeof(OAMEntry));
         std::memset(_sprite_shifter_pattern_lo, 0x00, 8 * sizeof(uint8_t));
         std::memset(_sprite_shifter_pattern_hi, 0x00, 8 * sizeof(uint8_t));
 
-        _sprite_zero_hit = false;
-        uint8_t num_sprite_entries = 0;
-
-        while (num_sprite_entries < 64 && _sprite_count < 9) {
-            int16_t diff = (int16_t)_scan_line - (int16_t)oam[num_sprite_entries].y;
-            int16_t sprite_size = control_register.sprite_size ? 16 : 8;
-
-            if (diff >= 0 && diff < sprite_size && _sprite_count < 8) {
-                if (num_sprite_entries == 0) {
-                    _sprite_zero_hit = true;
-                }
+        const SpriteLine &sprites = _sprite_lines[_scan_line];
+        _sprite_count = sprites.count;
+        _sprite_zero_hit = (_sprite_count > 0 && sprites.entries[0] == 0);
 
-                std::memcpy(&sprite_scanline[_sprite_count], &oam[num_sprite_entries],
-                                                                    sizeof(OAMEntry));
-                _sprite_count++;
-            }
+        for (uint8_t i = 0; i < _sprite_count; i++)
+            sprite_scanline[i] = oam[sprites.entries[i]];
 
-            num_sprite_entries++;
-        }
         status_register.sprite_overflow = (_sprite_count > 8);
     }
 
@@ -260,75 +464,32 @@ void ppu2C02::_render_fg() {
             uint8_t sprite_pattern_bits_lo, sprite_pattern_bits_hi;
             uint16_t sprite_pattern_addr_lo, sprite_pattern_addr_hi;
 
+            // Row of the sprite on the next line, counted from the bottom
+            // if the sprite is vertically flipped
+            int16_t row = _scan_line - sprite_scanline[i].y;
+            bool flipped_v = sprite_scanline[i].attr & 0x80;
+            if (flipped_v) row = 7 - row;
+
             // 8x8 sprite mode
             if (!control_register.sprite_size) {
-                // normal orientation
-                if (!(sprite_scanline[i].attr & 0x80)) {
-                    sprite_pattern_addr_lo =
-                        (control_register.pattern_sprite << 12)
-                        | (sprite_scanline[i].id << 4)
-                        | (_scan_line - sprite_scanline[i].y);
-
-                }
-                // vertically flipped
-                else {
-                    sprite_pattern_addr_lo =
-                        (control_register.pattern_sprite << 12)
-                        | (sprite_scanline[i].id << 4)
-                        | (7 - (_scan_line - sprite_scanline[i].y));
-                }
+                sprite_pattern_addr_lo = (control_register.pattern_sprite << 12)
+                                         | (sprite_scanline[i].id << 4) | row;
             }
 
-            // 8x16 sprite mode
+            // 8x16 sprite mode, the bottom tile follows the top one
             else {
-                // normal orientation
-                if (!(sprite_scanline[i].attr & 0x80)) {
-                    if (_scan_line - sprite_scanline[i].y < 8) {
-                        sprite_pattern_addr_lo =
-                            ((sprite_scanline[i].id & 0x01) << 12)
-                            | ((sprite_scanline[i].id & 0xFE) << 4)
-                            | ((_scan_line - sprite_scanline[i].y) & 0x07);
-                    }
-                    else {
-                        sprite_pattern_addr_lo =
-                            ((sprite_scanline[i].id & 0x01) << 12)
-                            | (((sprite_scanline[i].id & 0xFE) + 1) << 4)
-                            | ((_scan_line - sprite_scanline[i].y) & 0x07);
-                    }
-                }
-                // vertically flipped
-                else {
-                    if (_scan_line - sprite_scanline[i].y < 8) {
-                        sprite_pattern_addr_lo =
-                            ((sprite_scanline[i].id & 0x01) << 12)
-                            | (((sprite_scanline[i].id & 0xFE) + 1) << 4)
-                            | (7 - (_scan_line - sprite_scanline[i].y) & 0x07);
-                    }
-                    else {
-                        sprite_pattern_addr_lo =
-                            ((sprite_scanline[i].id & 0x01) << 12)
-                            | ((sprite_scanline[i].id & 0xFE) << 4)
-                            | (7 - (_scan_line - sprite_scanline[i].y) & 0x07);
-                    }
-                }
+                bool bottom = (_scan_line - sprite_scanline[i].y >= 8) != flipped_v;
+                sprite_pattern_addr_lo = ((sprite_scanline[i].id & 0x01) << 12)
+                                         | (((sprite_scanline[i].id & 0xFE) + bottom) << 4)
+                                         | (row & 0x07);
             }
 
             sprite_pattern_addr_hi = sprite_pattern_addr_lo + 8;
 
-            sprite_pattern_bits_lo = read_from_ppu_bus(sprite_pattern_addr_lo, false);
-            sprite_pattern_bits_hi = read_from_ppu_bus(sprite_pattern_addr_hi, false);
-
-            if (sprite_scanline[i].attr & 0x40) {
-                auto flip_byte = [] (uint8_t b) {
-                    b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
-                    b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
-                    b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
-                    return b;
-                };
-
-                sprite_pattern_bits_lo = flip_byte(sprite_pattern_bits_lo);
-                sprite_pattern_bits_hi = flip_byte(sprite_pattern_bits_hi);
-            }
+            // Horizontally flipped rows come straight from the tile cache
+            bool flipped = sprite_scanline[i].attr & 0x40;
+            sprite_pattern_bits_lo = _read_pattern(sprite_pattern_addr_lo, flipped);
+            sprite_pattern_bits_hi = _read_pattern(sprite_pattern_addr_hi, flipped);
 
             _sprite_shifter_pattern_lo[i] = sprite_pattern_bits_lo;
             _sprite_shifter_pattern_hi[i] = sprite_pattern_bits_hi;
@@ -352,6 +513,33 @@ void ppu2C02::clock() {
         }
     }
 
+    if (_output) {
+        uint8_t pixel = _compose_pixel();
+        if (_cycle < 256 && _scan_line < 240 && _scan_line >= 0) {
+            uint16_t idx = (_cycle - 1) + (_scan_line << 8);
+            assert(idx < NES_WINDOW_WIDTH * NES_WINDOW_HEIGHT);
+            _frame_buffer[idx] = _palette_indices[pixel];
+        }
+    }
+    else if (_sprite_zero_pending()) _compose_pixel();
+
+    // Increments cycles and scan lines for each clock cycle
+    _cycle++;
+
+    if (_cycle >= 341) {
+        _cycle = 0;
+        _scan_line++;
+
+        if (_scan_line >= 261) {
+            _scan_line = -1;
+            _frame_completed = true;
+        }
+    }
+}
+
+/* Background and foreground pixel at the current dot, as a palette offset
+ * (palette << 2 | pixel). Sets the sprite zero hit flag on collision */
+uint8_t ppu2C02::_compose_pixel() {
     // Display background pixels
     uint8_t bg_pixel = 0x00;
     uint8_t bg_palette = 0x00;
@@ -434,17 +622,62 @@ void ppu2C02::clock() {
         }
     }
 
-    assert(_video_text);
-    SDL_Color color = get_palette_from_offsets(final_pixel, final_palette);
+    return (final_palette << 2) | final_pixel;
+}
 
-    if (_cycle < 256 && _scan_line < 240 && _scan_line >= 0) {
-        _video_text->update_texture(
-            (_cycle - 1) + (_scan_line << 8), color.r, color.g, color.b);
+/* Runs the PPU for 'dots' clock ticks. The scanline renderer draws each
+ * visible scan line that fits entirely in them at once. The bus catches the
+ * PPU up before every register access, so such a line cannot have any
+ * register writes in the middle, lines that do are split and run dot by dot.
+ * Lines with rendering disabled and the vertical blank are skipped in bulk
+ * with either renderer */
+void ppu2C02::clock(uint32_t dots) {
+    while (dots > 0) {
+        uint32_t line_dots = (_scan_line == 0) ? 340 : 341;
+        bool rendering = mask_register.render_background || mask_register.render_sprites;
+
+        if (_scan_line >= 240) {
+            dots -= _skip_vblank(dots);
+        }
+        else if (_cycle == 0 && dots >= line_dots && !rendering) {
+            _render_blank_line();
+            dots -= line_dots;
+        }
+        else if (_renderer == SCANLINE && _cycle == 0 && _scan_line >= 0 &&
+                 dots >= line_dots) {
+            _render_scanline();
+            dots -= line_dots;
+        }
+        else {
+            clock();
+            dots--;
+        }
     }
+}
 
-    // Increments cycles and scan lines for each clock cycle
-    _cycle++;
+/* Runs up to 'dots' clock ticks of the post-render and vertical blank scan
+ * lines, stopping at the end of the current line. Nothing is fetched or
+ * drawn there and the shifters stay still, so the only events are vertical
+ * blank and a sprite zero hit from the pixel left in the shifters, which is
+ * the same on every dot. Returns the number of ticks run */
+uint32_t ppu2C02::_skip_vblank(uint32_t dots) {
+    uint32_t n = std::min<uint32_t>(dots, 341 - _cycle);
+
+    if (_scan_line == 241 && _cycle <= 1 && _cycle + n > 1) {
+        status_register.vertical_blank = 1;
+        if (control_register.enable_nmi) _nmi = true;
+    }
 
+    // Sprite zero hit only happens from dot 9 to dot 257
+    if (mask_register.render_background && mask_register.render_sprites &&
+        !status_register.sprite_zero_hit && _cycle < 258 && _cycle + n > 9) {
+        int16_t cycle = _cycle;
+        _cycle = std::max<int16_t>(_cycle, 9);
+        _compose_pixel();
+        _cycle = cycle;
+    }
+
+    _cycle += n;
     if (_cycle >= 341) {
         _cycle = 0;
         _scan_line++;
@@ -454,12 +687,152 @@ void ppu2C02::clock() {
             _frame_completed = true;
         }
     }
+    return n;
+}
+
+/* Forced blank - all dots of scan line '_scan_line' (pre-render or visible)
+ * from its first one, while rendering is disabled. The visible pixels all
+ * have the backdrop color. Shifters stay still and fetches only matter for
+ * the last tiles prefetched and the sprites of the next line, the rest of
+ * the line is skipped */
+void ppu2C02::_render_blank_line() {
+    uint8_t backdrop = _palette_indices[0];
+
+    if (_scan_line >= 0) {
+        if (_output) {
+            if (_scan_line > 0) _frame_buffer[(_scan_line << 8) - 1] = backdrop;
+            std::memset(&_frame_buffer[_scan_line << 8], backdrop, NES_WINDOW_WIDTH - 1);
+        }
+    }
+    else {
+        status_register.vertical_blank = 0;
+        status_register.sprite_overflow = 0;
+        status_register.sprite_zero_hit = 0;
+
+        std::memset(_sprite_shifter_pattern_lo, 0x00, 8 * sizeof(uint8_t));
+        std::memset(_sprite_shifter_pattern_hi, 0x00, 8 * sizeof(uint8_t));
+    }
+
+    // Sprite evaluation
+    _cycle = 257;
+    _render_fg();
+
+    for (_cycle = 321; _cycle < 338; _cycle++) _fetch_bg_tile();
+    _bg_next_tile_id = read_from_ppu_bus((0x2000 | (vram_addr.reg & 0x0FFF)), false);
+
+    _cycle = 340;
+    _render_fg();
+
+    _cycle = 0;
+    _scan_line++;
+}
+
+/* Scanline renderer - all dots of visible scan line '_scan_line' from its
+ * first one. Same result as 'clock()' for each dot, but skips the dots that
+ * neither fetch, output a pixel nor can set sprite zero hit */
+void ppu2C02::_render_scanline() {
+    // Dot 0 outputs the last pixel of the previous line, dot (0, 0) is skipped
+    if (_scan_line > 0) {
+        if (_output) {
+            uint16_t idx = (_scan_line << 8) - 1;
+            _frame_buffer[idx] = _palette_indices[_compose_pixel()];
+        }
+        else if (_sprite_zero_pending()) _compose_pixel();
+    }
+
+    for (_cycle = 1; _cycle < 258; _cycle++) {
+        if (_cycle >= 2) {
+            _update_shifters();
+            _fetch_bg_tile();
+        }
+
+        if (_cycle == 256) _increment_scroll_y();
+        if (_cycle == 257) {
+            _load_bg_shifters();
+            _transfer_address_x();
+            _render_fg();
+        }
+
+        if (_output) {
+            uint8_t pixel = _compose_pixel();
+            if (_cycle < 256) {
+                uint16_t idx = (_cycle - 1) + (_scan_line << 8);
+                _frame_buffer[idx] = _palette_indices[pixel];
+            }
+        }
+        else if (_sprite_zero_pending()) _compose_pixel();
+    }
+
+    // Prefetch of the first two tiles of the next line
+    for (_cycle = 321; _cycle < 338; _cycle++) {
+        _update_shifters();
+        _fetch_bg_tile();
+    }
+
+    _bg_next_tile_id = read_from_ppu_bus((0x2000 | (vram_addr.reg & 0x0FFF)), false);
+
+    // Sprite patterns of the next line
+    _cycle = 340;
+    _render_fg();
+
+    _cycle = 0;
+    _scan_line++;
 }
 
 bool ppu2C02::frame_completed() { return _frame_completed; }
 
+void ppu2C02::set_output(bool enabled) { _output = enabled; }
+
+bool ppu2C02::output_enabled() { return _output; }
+
+/* Whether composing the current pixel can still set sprite zero hit, the only
+ * thing besides the pixel itself that '_compose_pixel()' changes */
+bool ppu2C02::_sprite_zero_pending() {
+    return _sprite_zero_hit && !status_register.sprite_zero_hit &&
+           mask_register.render_background && mask_register.render_sprites;
+}
+
+void ppu2C02::set_renderer(renderer r) { _renderer = r; }
+
+ppu2C02::renderer ppu2C02::get_renderer() { return _renderer; }
+
 void ppu2C02::reset_frame() { _frame_completed = false; }
 
+/* Number of clock ticks before the PPU starts the given dot (0 if the next
+ * tick is that dot). Dot (0, 0) always skips to (0, 2) */
+uint32_t ppu2C02::dots_until(int16_t scan_line, int16_t cycle) {
+    const int32_t frame_dots = 262 * 341;
+    const int32_t skipped_dot = 341;     // Dot index of (0, 0)
+
+    int32_t from = (_scan_line + 1) * 341 + _cycle;
+    int32_t to = (scan_line + 1) * 341 + cycle;
+
+    if (to >= from)
+        return to - from - ((from <= skipped_dot && to > skipped_dot) ? 1 : 0);
+
+    // Wraps around to the next frame
+    return (frame_dots - from - (from <= skipped_dot ? 1 : 0))
+                + (to - (to > skipped_dot ? 1 : 0));
+}
+
+/* Number of clock ticks during which reading the status register keeps
+ * returning the same value, as long as the CPU does not write to the PPU.
+ * Vertical blank is set at (241, 1) and all flags are cleared at (-1, 1).
+ * Sprite zero hit can be set on any dot while rendering is enabled, since
+ * the sprite shifters keep their last state outside of the visible area */
+uint32_t ppu2C02::dots_until_status_change() {
+    if (status_register.vertical_blank) return 0;
+    if (mask_register.render_background && mask_register.render_sprites &&
+        !status_register.sprite_zero_hit) return 0;
+
+    return std::min(dots_until(241, 1), dots_until(-1, 1));
+}
+
+/* Value a status register read returns, without clearing any flags */
+uint8_t ppu2C02::peek_status() {
+    return (status_register.reg & 0xE0) | (_ppu_data_buffer & 0x1F);
+}
+
 void ppu2C02::reset() {
     // Reset buffers
     _address_latch = 0x00;
@@ -484,6 +857,7 @@ void ppu2C02::reset() {
     control_register.reg    = 0x00;
     vram_addr.reg           = 0x0000;
     tram_addr.reg           = 0x0000;
+    _refresh_palette_cache();
 }
 
 /*=============================================================================
@@ -535,16 +909,20 @@ void ppu2C02::write_to_main_bus(uint16_t addr, uint8_t data) {
             tram_addr.nametable_x = control_register.nametable_x;
             tram_addr.nametable_y = control_register.nametable_y;
             break;
-        case 0x0001: // Mask register
+        case 0x0001: { // Mask register
+            // Grayscale and color emphasis bits change the palette colors
+            uint8_t changed = mask_register.reg ^ data;
             mask_register.reg = data;
+            if (changed & 0xE1) _refresh_palette_cache();
             break;
+        }
         case 0x0002: // Status register
             break;
         case 0x0003: // OAM Address
             oam_addr = data;
             break;
         case 0x0004: // OAM Data
-            oam_ptr[oam_addr] = data;
+            write_oam(oam_addr, data);
             break;
         case 0x0005: // Scroll
             if (_address_latch == 0) {
@@ -591,26 +969,7 @@ uint8_t ppu2C02::read_from_ppu_bus(uint16_t addr, bool read_only) {
 
     if (addr >= NAME_TABLE_ADDR_LOWER && addr <= NAME_TABLE_ADDR_UPPER) {
         addr &= 0x0FFF;
-        if (cartridge->mirror == Cartridge::MIRROR::VERTICAL) {
-            if (addr >= 0x0000 && addr <= 0x03FF)
-                data = ppu_name_table[0][addr & 0x03FF];
-            else if (addr >= 0x0400 && addr <= 0x07FF)
-                data = ppu_name_table[1][addr & 0x03FF];
-            else if (addr >= 0x0800 && addr <= 0x0BFF)
-                data = ppu_name_table[0][addr & 0x03FF];
-            else if (addr >= 0x0C00 && addr <= 0x0FFF)
-                data = ppu_name_table[1][addr & 0x03FF];
-        }
-        else if (cartridge->mirror == Cartridge::MIRROR::HORIZONTAL) {
-            if (addr >= 0x0000 && addr <= 0x03FF)
-                data = ppu_name_table[0][addr & 0x03FF];
-            else if (addr >= 0x0400 && addr <= 0x07FF)
-                data = ppu_name_table[0][addr & 0x03FF];
-            else if (addr >= 0x0800 && addr <= 0x0BFF)
-                data = ppu_name_table[1][addr & 0x03FF];
-            else if (addr >= 0x0C00 && addr <= 0x0FFF)
-                data = ppu_name_table[1][addr & 0x03FF];
-        }
+        data = _nametables[addr >> 10][addr & 0x03FF];
     }
     else if (addr >= PALETTE_ADDR_LOWER && addr <= PALETTE_ADDR_UPPER) {
         addr &= 0x001F;
@@ -629,28 +988,15 @@ void ppu2C02::write_to_ppu_bus(uint16_t addr, uint8_t data) {
     addr &= 0x3FFF;
     cartridge->handle_ppu_write(addr, data);
 
+    // CHR RAM, decoded tile is stale
+    if (addr <= PATTERN_ADDR_UPPER) {
+        _tile_valid[addr >> 4] = false;
+        _chr_serial++;
+    }
+
     if (addr >= NAME_TABLE_ADDR_LOWER && addr <= NAME_TABLE_ADDR_UPPER) {
         addr &= 0x0FFF;
-        if (cartridge->mirror == Cartridge::MIRROR::VERTICAL) {
-            if (addr >= 0x0000 && addr <= 0x03FF)
-                ppu_name_table[0][addr & 0x03FF] = data;
-            else if (addr >= 0x0400 && addr <= 0x07FF)
-                ppu_name_table[1][addr & 0x03FF] = data;
-            else if (addr >= 0x0800 && addr <= 0x0BFF)
-                ppu_name_table[0][addr & 0x03FF] = data;
-            else if (addr >= 0x0C00 && addr <= 0x0FFF)
-                ppu_name_table[1][addr & 0x03FF] = data;
-        }
-        else if (cartridge->mirror == Cartridge::MIRROR::HORIZONTAL) {
-            if (addr >= 0x0000 && addr <= 0x03FF)
-                ppu_name_table[0][addr & 0x03FF] = data;
-            else if (addr >= 0x0400 && addr <= 0x07FF)
-                ppu_name_table[0][addr & 0x03FF] = data;
-            else if (addr >= 0x0800 && addr <= 0x0BFF)
-                ppu_name_table[1][addr & 0x03FF] = data;
-            else if (addr >= 0x0C00 && addr <= 0x0FFF)
-                ppu_name_table[1][addr & 0x03FF] = data;
-        }
+        _nametables[addr >> 10][addr & 0x03FF] = data;
     }
     else if (addr >= PALETTE_ADDR_LOWER && addr <= PALETTE_ADDR_UPPER) {
         addr &= 0x001F;
@@ -659,10 +1005,105 @@ void ppu2C02::write_to_ppu_bus(uint16_t addr, uint8_t data) {
         else if (addr == 0x0018)    addr = 0x0008;
         else if (addr == 0x001C)    addr = 0x000C;
         ppu_palette_table[addr] = data;
+        _refresh_palette_cache();
     }
 }
 
 /* NMI */
 bool ppu2C02::nmi() { return _nmi; }
 
+bool ppu2C02::nmi_enabled() { return control_register.enable_nmi; }
+
 void ppu2C02::reset_nmi() { _nmi = false; }
+
+/*=============================================================================
+ * SNAPSHOTS
+ *===========================================================================*/
+void ppu2C02::save_state(State &state) {
+    state.status = status_register.reg;
+    state.mask = mask_register.reg;
+    state.control = control_register.reg;
+    state.vram_addr = vram_addr.reg;
+    state.tram_addr = tram_addr.reg;
+    std::memcpy(state.oam, oam, sizeof(oam));
+    state.oam_addr = oam_addr;
+
+    std::memcpy(state.sprite_scanline, sprite_scanline, sizeof(sprite_scanline));
+    state.sprite_count = _sprite_count;
+    std::memcpy(state.sprite_shifter_pattern_lo, _sprite_shifter_pattern_lo,
+                sizeof(_sprite_shifter_pattern_lo));
+    std::memcpy(state.sprite_shifter_pattern_hi, _sprite_shifter_pattern_hi,
+                sizeof(_sprite_shifter_pattern_hi));
+    state.sprite_zero_hit = _sprite_zero_hit;
+    state.sprite_zero_rendered = _sprite_zero_rendered;
+
+    state.fine_x = _fine_x;
+    state.bg_next_tile_id = _bg_next_tile_id;
+    state.bg_next_tile_attrib = _bg_next_tile_attrib;
+    state.bg_next_tile_lsb = _bg_next_tile_lsb;
+    state.bg_next_tile_msb = _bg_next_tile_msb;
+    state.bg_shifter_pattern_lo = _bg_shifter_pattern_lo;
+    state.bg_shifter_pattern_hi = _bg_shifter_pattern_hi;
+    state.bg_shifter_attrib_lo = _bg_shifter_attrib_lo;
+    state.bg_shifter_attrib_hi = _bg_shifter_attrib_hi;
+    state.address_latch = _address_latch;
+    state.ppu_data_buffer = _ppu_data_buffer;
+
+    std::memcpy(state.name_table, ppu_name_table, sizeof(ppu_name_table));
+    std::memcpy(state.palette_table, ppu_palette_table, sizeof(ppu_palette_table));
+
+    state.scan_line = _scan_line;
+    state.cycle = _cycle;
+    state.frame_completed = _frame_completed;
+    state.nmi = _nmi;
+}
+
+/* Inverse of 'save_state()'. Expects the cartridge to be restored already, the
+ * nametable mapping comes from its mirroring mode */
+void ppu2C02::load_state(const State &state) {
+    bool palette_changed = state.mask != mask_register.reg ||
+        std::memcmp(state.palette_table, ppu_palette_table, sizeof(ppu_palette_table)) != 0;
+    bool oam_changed = std::memcmp(state.oam, oam, sizeof(oam)) != 0;
+
+    status_register.reg = state.status;
+    mask_register.reg = state.mask;
+    control_register.reg = state.control;
+    vram_addr.reg = state.vram_addr;
+    tram_addr.reg = state.tram_addr;
+    std::memcpy(oam, state.oam, sizeof(oam));
+    oam_addr = state.oam_addr;
+
+    std::memcpy(sprite_scanline, state.sprite_scanline, sizeof(sprite_scanline));
+    _sprite_count = state.sprite_count;
+    std::memcpy(_sprite_shifter_pattern_lo, state.sprite_shifter_pattern_lo,
+                sizeof(_sprite_shifter_pattern_lo));
+    std::memcpy(_sprite_shifter_pattern_hi, state.sprite_shifter_pattern_hi,
+                sizeof(_sprite_shifter_pattern_hi));
+    _sprite_zero_hit = state.sprite_zero_hit;
+    _sprite_zero_rendered = state.sprite_zero_rendered;
+
+    _fine_x = state.fine_x;
+    _bg_next_tile_id = state.bg_next_tile_id;
+    _bg_next_tile_attrib = state.bg_next_tile_attrib;
+    _bg_next_tile_lsb = state.bg_next_tile_lsb;
+    _bg_next_tile_msb = state.bg_next_tile_msb;
+    _bg_shifter_pattern_lo = state.bg_shifter_pattern_lo;
+    _bg_shifter_pattern_hi = state.bg_shifter_pattern_hi;
+    _bg_shifter_attrib_lo = state.bg_shifter_attrib_lo;
+    _bg_shifter_attrib_hi = state.bg_shifter_attrib_hi;
+    _address_latch = state.address_latch;
+    _ppu_data_buffer = state.ppu_data_buffer;
+
+    std::memcpy(ppu_name_table, state.name_table, sizeof(ppu_name_table));
+    std::memcpy(ppu_palette_table, state.palette_table, sizeof(ppu_palette_table));
+
+    _scan_line = state.scan_line;
+    _cycle = state.cycle;
+    _frame_completed = state.frame_completed;
+    _nmi = state.nmi;
+
+    // Derived state, the CHR tile cache follows the cartridge bank serial
+    map_nametables();
+    if (palette_changed) _refresh_palette_cache();
+    if (oam_changed) _sprite_lines_valid = false;
+}
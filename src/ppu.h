@@ -2,38 +2,80 @@
 #define PPU_H_
 
 #include <memory>
-#include "texture.h"
+#include <vector>
+#include <cstring>
+#include <cassert>
 #include "mem.h"
 #include "cartridge.h"
 
 // Forward-declaration for class 'Bus' defined in 'bus.cpp'
 class Bus;
 
+/* NES resolution */
+#define NES_WINDOW_WIDTH 256
+#define NES_WINDOW_HEIGHT 240
+
+#define ALPHA_OPAQUE 0xFF
+
 class ppu2C02 {
 public:
     ppu2C02();
     ~ppu2C02();
 
     void clock();
+    void clock(uint32_t dots);
     void connect_to_bus(Bus *b);
     void connect_to_cartridge(const std::shared_ptr<Cartridge>& _cartridge);
+    void map_nametables();
     void reset();
 
 /*=============================================================================
  * GUI HELPERS
  *===========================================================================*/
-/* GUI helpers - used in 'Emulator' class to render video */
+/* RGBA color - same byte layout as the SDL_PIXELFORMAT_RGBA32 textures */
+public:
+    struct Color {
+        uint8_t r;
+        uint8_t g;
+        uint8_t b;
+        uint8_t a;
+    };
+
+/* GUI helpers - used in 'Emulator' class to render video. All pixel buffers
+ * are RGBA, 4 bytes per pixel */
 public:
-    const SDL_Color &get_palette_from_offsets(uint8_t idx, uint8_t palette);
-    void get_chr_rom_texture(std::shared_ptr<Texture> &chr_rom_text,
-                                                uint8_t idx, uint8_t palette);
+    const Color &get_palette_from_offsets(uint8_t idx, uint8_t palette);
+    void get_chr_rom_texture(uint8_t *chr_rom_pixels, uint8_t idx, uint8_t palette);
+    void get_palettes_texture(uint8_t *palettes_pixels, uint8_t palette);
+
+    // Bumped whenever the pattern tables or the palette colors change, so
+    // that GUI panels only redraw when needed
+    uint32_t get_chr_serial();
+    uint32_t get_palette_serial();
+
+    const uint8_t *get_indexed_frame();
+    static void expand_frame(const uint8_t *indexed_frame, uint8_t *rgba_pixels);
+
+    // Frames run without output keep everything the CPU can observe exact,
+    // but skip composing pixels and leave the frame buffer untouched
+    void set_output(bool enabled);
+    bool output_enabled();
 
-    void set_video_texture(std::shared_ptr<Texture> &video_text);
-    void get_palettes_texture(std::shared_ptr<Texture> &palettes_text,
-                                                uint8_t palette);
 private:
-    std::shared_ptr<Texture> _video_text;
-    static const SDL_Color palettes[0x40];
+    bool _output = true;
+    bool _sprite_zero_pending();
+
+    // NES video output, one system palette index per pixel. Color emphasis is
+    // not emulated, its three mask bits do not fit in the two spare index bits
+    std::vector<uint8_t> _frame_buffer;
+    static const Color palettes[0x40];
+
+    // System palette indices and colors of the 32 palette memory entries, with
+    // the mask register applied. Refreshed on palette writes and mask changes
+    uint8_t _palette_indices[32];
+    Color _palette_cache[32];
+    uint32_t _palette_serial = 0;
+    void _refresh_palette_cache();
 
 private:
     Bus *bus;
@@ -119,10 +161,23 @@ private:
     bool _sprite_zero_hit = false;
     bool _sprite_zero_rendered = false;
 
+    // Sprites in range of each scanline, rebuilt from OAM when it changes
+    struct SpriteLine {
+        uint8_t count;
+        uint8_t entries[8];         // OAM indices, in OAM order
+    };
+
+    SpriteLine _sprite_lines[240];
+    bool _sprite_lines_valid = false;
+    bool _sprite_lines_size = false;    // Sprite size the lines were built for
+
+    void _build_sprite_lines();
     void _render_fg();
+    uint8_t _compose_pixel();
 
 public:
     uint8_t *oam_ptr = (uint8_t *)oam;
+    void write_oam(uint8_t addr, uint8_t data);
 
 /* PPU background rendering helpers */
 private:
@@ -150,15 +205,38 @@ private:
     void _update_shifters();
 
     void _render_bg();
+    void _fetch_bg_tile();
+
+/* CHR tile cache - pattern table tiles decoded on first use, dropped when the
+ * PPU writes to CHR RAM or the mapper switches banks */
+private:
+    struct Tile {
+        uint8_t planes[2][8];               // Bit planes (lsb, msb) of each row
+        uint8_t flipped[2][8];              // Same, horizontally flipped
+        uint8_t pixels[8][8];               // 2-bit pixel indices
+    };
+
+    Tile _tiles[512];
+    bool _tile_valid[512];
+    uint32_t _tiles_bank_serial;
+    uint32_t _chr_serial = 0;
+
+    const Tile &_tile(uint16_t idx);
+    uint8_t _read_pattern(uint16_t addr, bool flipped);
+    void _invalidate_tiles();
 
 /*=============================================================================
  * PPU RAM
  *===========================================================================*/
 private:
-    uint8_t ppu_name_table[2][_1_KB];
+    // Two pages of VRAM, plus the two extra pages four-screen cartridges carry
+    uint8_t ppu_name_table[4][_1_KB];
     //uint8_t ppu_pattern_table[2][_4_KB];
     uint8_t ppu_palette_table[32];
 
+    // VRAM page behind each of the 4 nametables, set by the mirroring mode
+    uint8_t *_nametables[4];
+
     int16_t _scan_line;
     int16_t _cycle;
     bool _frame_completed;
@@ -167,6 +245,28 @@ public:
     bool frame_completed();
     void reset_frame();
 
+    uint32_t dots_until(int16_t scan_line, int16_t cycle);
+    uint32_t dots_until_status_change();
+    uint8_t peek_status();
+
+/* Renderers - the dot renderer runs one dot per clock tick, the scanline
+ * renderer draws whole visible scan lines when the bus lets it run that long */
+public:
+    enum renderer : uint8_t {
+        DOT,
+        SCANLINE
+    };
+
+    void set_renderer(renderer r);
+    renderer get_renderer();
+
+private:
+    renderer _renderer;
+
+    void _render_scanline();
+    void _render_blank_line();
+    uint32_t _skip_vblank(uint32_t dots);
+
 /*=============================================================================
  * BUS COMMUNICATION
  *===========================================================================*/
@@ -183,6 +283,41 @@ private:
 
 public:
     bool nmi();
+    bool nmi_enabled();
     void reset_nmi();
+
+/*=============================================================================
+ * SNAPSHOTS - registers, memories and rendering state. The caches derived from
+ * them are rebuilt on load, the frame buffer is not part of it
+ *===========================================================================*/
+public:
+    struct State {
+        uint8_t status, mask, control;
+        uint16_t vram_addr, tram_addr;
+        OAMEntry oam[64];
+        uint8_t oam_addr;
+
+        OAMEntry sprite_scanline[8];
+        uint8_t sprite_count;
+        uint8_t sprite_shifter_pattern_lo[8];
+        uint8_t sprite_shifter_pattern_hi[8];
+        bool sprite_zero_hit, sprite_zero_rendered;
+
+        uint8_t fine_x;
+        uint8_t bg_next_tile_id, bg_next_tile_attrib, bg_next_tile_lsb, bg_next_tile_msb;
+        uint16_t bg_shifter_pattern_lo, bg_shifter_pattern_hi;
+        uint16_t bg_shifter_attrib_lo, bg_shifter_attrib_hi;
+        uint8_t address_latch, ppu_data_buffer;
+
+        uint8_t name_table[4][_1_KB];
+        uint8_t palette_table[32];
+
+        int16_t scan_line, cycle;
+        bool frame_completed;
+        bool nmi;
+    };
+
+    void save_state(State &state);
+    void load_state(const State &state);
 };
 #endif
@@ -0,0 +1,227 @@
+#include <cstring>
+#include "save_state.h"
+
+static const char MAGIC[4] = { 'N', 'E', 'S', 'S' };
+
+// Unchanged bytes a run of cartridge memory spans before it is split in two,
+// about the size of a run header
+#define RUN_GAP 8
+
+/*=============================================================================
+ * BLOB ACCESS - values of any integer type, least significant byte first
+ *===========================================================================*/
+namespace {
+
+class Writer {
+public:
+    Writer(std::vector<uint8_t> &_blob) : blob(_blob) {}
+
+    template <typename T>
+    void value(const T &v) {
+        uint64_t bits = (uint64_t)v;
+        for (size_t i = 0; i < sizeof(T); i++) blob.push_back((bits >> (i << 3)) & 0xFF);
+    }
+
+    void bytes(const uint8_t *data, size_t size) { blob.insert(blob.end(), data, data + size); }
+
+private:
+    std::vector<uint8_t> &blob;
+};
+
+class Reader {
+public:
+    Reader(const std::vector<uint8_t> &blob) :
+        pos(blob.data()), end(blob.data() + blob.size()), ok(true) {}
+
+    template <typename T>
+    void value(T &v) {
+        if (!take(sizeof(T))) { v = T(); return; }
+
+        const uint8_t *data = pos - sizeof(T);
+        uint64_t bits = 0;
+        for (size_t i = 0; i < sizeof(T); i++) bits |= (uint64_t)data[i] << (i << 3);
+        v = (T)bits;
+    }
+
+    void bytes(uint8_t *data, size_t size) {
+        if (take(size)) std::memcpy(data, pos - size, size);
+    }
+
+    bool done() { return ok && pos == end; }
+    bool failed() { return !ok; }
+
+private:
+    const uint8_t *pos;
+    const uint8_t *end;
+    bool ok;
+
+    // Moves past the next 'size' bytes, false if the blob is too short
+    bool take(size_t size) {
+        if (!ok || (size_t)(end - pos) < size) { ok = false; return false; }
+        pos += size;
+        return true;
+    }
+};
+
+}
+
+/*=============================================================================
+ * STATE LAYOUT - shared by reading and writing, 'Archive' is 'Writer' with a
+ * const 'Bus::State' or 'Reader' with a mutable one
+ *===========================================================================*/
+template <typename Archive, typename State>
+static void transfer_cpu(Archive &ar, State &cpu) {
+    ar.value(cpu.a); ar.value(cpu.x); ar.value(cpu.y); ar.value(cpu.stkp);
+    ar.value(cpu.status); ar.value(cpu.pc);
+    ar.value(cpu.fetched); ar.value(cpu.temp); ar.value(cpu.addr_abs); ar.value(cpu.addr_rel);
+    ar.value(cpu.opcode); ar.value(cpu.instr_pc); ar.value(cpu.operand);
+    ar.value(cpu.next_operand); ar.value(cpu.implied); ar.value(cpu.decoded);
+    ar.value(cpu.remaining_cycles); ar.value(cpu.clock_count); ar.value(cpu.instr_count);
+    ar.value(cpu.flag_n); ar.value(cpu.flag_z); ar.value(cpu.flag_c); ar.value(cpu.flag_v);
+}
+
+template <typename Archive, typename State>
+static void transfer_ppu(Archive &ar, State &ppu) {
+    ar.value(ppu.status); ar.value(ppu.mask); ar.value(ppu.control);
+    ar.value(ppu.vram_addr); ar.value(ppu.tram_addr);
+    for (auto &entry : ppu.oam) {
+        ar.value(entry.y); ar.value(entry.id); ar.value(entry.attr); ar.value(entry.x);
+    }
+    ar.value(ppu.oam_addr);
+
+    for (auto &entry : ppu.sprite_scanline) {
+        ar.value(entry.y); ar.value(entry.id); ar.value(entry.attr); ar.value(entry.x);
+    }
+    ar.value(ppu.sprite_count);
+    ar.bytes(ppu.sprite_shifter_pattern_lo, sizeof(ppu.sprite_shifter_pattern_lo));
+    ar.bytes(ppu.sprite_shifter_pattern_hi, sizeof(ppu.sprite_shifter_pattern_hi));
+    ar.value(ppu.sprite_zero_hit); ar.value(ppu.sprite_zero_rendered);
+
+    ar.value(ppu.fine_x);
+    ar.value(ppu.bg_next_tile_id); ar.value(ppu.bg_next_tile_attrib);
+    ar.value(ppu.bg_next_tile_lsb); ar.value(ppu.bg_next_tile_msb);
+    ar.value(ppu.bg_shifter_pattern_lo); ar.value(ppu.bg_shifter_pattern_hi);
+    ar.value(ppu.bg_shifter_attrib_lo); ar.value(ppu.bg_shifter_attrib_hi);
+    ar.value(ppu.address_latch); ar.value(ppu.ppu_data_buffer);
+
+    ar.bytes(&ppu.name_table[0][0], sizeof(ppu.name_table));
+    ar.bytes(ppu.palette_table, sizeof(ppu.palette_table));
+
+    ar.value(ppu.scan_line); ar.value(ppu.cycle);
+    ar.value(ppu.frame_completed); ar.value(ppu.nmi);
+}
+
+template <typename Archive, typename State>
+static void transfer_bus(Archive &ar, State &bus) {
+    ar.bytes(bus.cpu_ram, sizeof(bus.cpu_ram));
+    ar.bytes(bus.controller, sizeof(bus.controller));
+    ar.bytes(bus.controller_states, sizeof(bus.controller_states));
+    ar.value(bus.clock_cycles);
+    ar.value(bus.dma_page); ar.value(bus.dma_addr); ar.value(bus.dma_data);
+    ar.value(bus.dma_idle); ar.value(bus.dma_transfer);
+}
+
+/* PPU values used as array indices or shift counts have to be in range, or a
+ * malformed blob would make the PPU access memory out of bounds */
+static bool valid_ppu(const ppu2C02::State &ppu) {
+    return ppu.sprite_count <= 8 && ppu.fine_x <= 7 &&
+           ppu.scan_line >= -1 && ppu.scan_line <= 260 &&
+           ppu.cycle >= 0 && ppu.cycle <= 340;
+}
+
+/* Cartridge memory as runs of bytes differing from 'image', each an offset and
+ * a length followed by the bytes. A zero length run ends the list */
+static void write_runs(Writer &w, const std::vector<uint8_t> &memory,
+                       const std::vector<uint8_t> &image) {
+    size_t size = memory.size();
+    size_t i = 0;
+    while (i < size) {
+        // Whole unchanged pages at once
+        if ((i & 0xFF) == 0 && i + 0x0100 <= size &&
+            std::memcmp(&memory[i], &image[i], 0x0100) == 0) {
+            i += 0x0100;
+            continue;
+        }
+        if (memory[i] == image[i]) { i++; continue; }
+
+        size_t start = i;
+        size_t run_end = i + 1;
+        for (size_t unchanged = 0; i < size && unchanged < RUN_GAP; i++) {
+            if (memory[i] == image[i]) unchanged++;
+            else { unchanged = 0; run_end = i + 1; }
+        }
+        i = run_end;
+
+        w.value((uint32_t)start);
+        w.value((uint32_t)(run_end - start));
+        w.bytes(&memory[start], run_end - start);
+    }
+    w.value((uint32_t)0);
+    w.value((uint32_t)0);
+}
+
+static bool read_runs(Reader &r, std::vector<uint8_t> &memory,
+                      const std::vector<uint8_t> &image) {
+    memory.assign(image.begin(), image.end());
+    while (true) {
+        uint32_t offset = 0, length = 0;
+        r.value(offset);
+        r.value(length);
+        if (r.failed()) return false;
+        if (length == 0) return true;
+        if (offset > memory.size() || length > memory.size() - offset) return false;
+        r.bytes(&memory[offset], length);
+    }
+}
+
+/*=============================================================================
+ * SAVE STATE METHODS
+ *===========================================================================*/
+void SaveState::write(const Bus::State &state, Cartridge &cartridge,
+                      std::vector<uint8_t> &blob) {
+    blob.clear();
+    Writer w(blob);
+
+    w.bytes((const uint8_t *)MAGIC, sizeof(MAGIC));
+    w.value((uint16_t)VERSION);
+    w.value(cartridge.get_rom_checksum());
+    w.value((uint32_t)state.cartridge.prg_memory.size());
+    w.value((uint32_t)state.cartridge.chr_memory.size());
+
+    transfer_cpu(w, state.cpu);
+    transfer_ppu(w, state.ppu);
+    transfer_bus(w, state);
+
+    w.bytes(state.cartridge.mapper.regs, sizeof(state.cartridge.mapper.regs));
+    write_runs(w, state.cartridge.prg_memory, cartridge.get_prg_image());
+    write_runs(w, state.cartridge.chr_memory, cartridge.get_chr_image());
+}
+
+bool SaveState::read(const std::vector<uint8_t> &blob, Cartridge &cartridge,
+                     Bus::State &state) {
+    Reader r(blob);
+
+    uint8_t magic[sizeof(MAGIC)] = { 0 };
+    uint16_t version = 0;
+    uint32_t checksum = 0, prg_size = 0, chr_size = 0;
+    r.bytes(magic, sizeof(magic));
+    r.value(version);
+    r.value(checksum);
+    r.value(prg_size);
+    r.value(chr_size);
+
+    if (r.failed() || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION ||
+        checksum != cartridge.get_rom_checksum() ||
+        prg_size != cartridge.get_prg_image().size() ||
+        chr_size != cartridge.get_chr_image().size()) return false;
+
+    transfer_cpu(r, state.cpu);
+    transfer_ppu(r, state.ppu);
+    transfer_bus(r, state);
+    if (!valid_ppu(state.ppu)) return false;
+
+    r.bytes(state.cartridge.mapper.regs, sizeof(state.cartridge.mapper.regs));
+    if (!read_runs(r, state.cartridge.prg_memory, cartridge.get_prg_image())) return false;
+    if (!read_runs(r, state.cartridge.chr_memory, cartridge.get_chr_image())) return false;
+    return r.done();
+}
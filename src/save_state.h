@@ -0,0 +1,27 @@
+#ifndef SAVE_STATE_H_
+#define SAVE_STATE_H_
+
+#include <vector>
+#include <inttypes.h>
+#include "bus.h"
+
+/* Binary save states - a 'Bus::State' snapshot in one contiguous blob. Fields
+ * are written one by one in little endian, so blobs do not depend on struct
+ * layout or host byte order. Cartridge memory is stored as the runs that
+ * differ from the ROM file, and blobs only load with the ROM they came from.
+ * 'VERSION' goes up whenever the layout changes */
+class SaveState {
+public:
+    static const uint16_t VERSION = 1;
+
+    // Replaces the contents of 'blob', reusing its storage
+    static void write(const Bus::State &state, Cartridge &cartridge,
+                      std::vector<uint8_t> &blob);
+
+    // Fills 'state' from 'blob', false if it is malformed, from another
+    // version or from another ROM. 'state' is undefined after a failure
+    static bool read(const std::vector<uint8_t> &blob, Cartridge &cartridge,
+                     Bus::State &state);
+};
+
+#endif
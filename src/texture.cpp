@@ -1,8 +1,10 @@
+#include <cstring>
 #include "texture.h"
 
 /* Constructor */
 Texture::Texture(SDL_Renderer *_renderer, uint16_t w, uint16_t h, const SDL_Rect &_bound) :
-    width(w), height(h), renderer(_renderer), boundaries(_bound)
+    width(w), height(h), renderer(_renderer), boundaries(_bound), dirty(true),
+    locked_pixels(nullptr), locked_pitch(0)
 {
     assert(_renderer);
     texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32,
@@ -16,6 +18,7 @@ Texture::~Texture() { assert(texture); SDL_DestroyTexture(texture); }
 /* Update texture */
 void Texture::update_texture(uint16_t idx, uint8_t r, uint8_t g, uint8_t b) {
     assert(idx < width * height);
+    dirty = true;
 
     pixels_arr[(idx << 2)]     = r;
     pixels_arr[(idx << 2) + 1] = g;
@@ -23,10 +26,44 @@ void Texture::update_texture(uint16_t idx, uint8_t r, uint8_t g, uint8_t b) {
     pixels_arr[(idx << 2) + 3] = SDL_ALPHA_OPAQUE;
 }
 
-/* Render texture */
+/* Raw RGBA pixels, to be filled in by the caller */
+uint8_t *Texture::get_pixels() { dirty = true; return pixels_arr.data(); }
+
+/* Locks the streaming texture and returns its memory, to be filled in with
+ * RGBA pixels by the caller until 'unlock_pixels()'. If the texture rows are
+ * padded, the caller fills in the local buffer and it is copied on unlock */
+uint8_t *Texture::lock_pixels() {
+    assert(texture);
+    assert(!locked_pixels);
+
+    void *pixels = nullptr;
+    if (SDL_LockTexture(texture, nullptr, &pixels, &locked_pitch) != 0)
+        return get_pixels();
+
+    locked_pixels = (uint8_t *)pixels;
+    return (locked_pitch == width * 4) ? locked_pixels : pixels_arr.data();
+}
+
+void Texture::unlock_pixels() {
+    if (!locked_pixels) return;
+
+    if (locked_pitch != width * 4) {
+        for (uint16_t y = 0; y < height; y++)
+            std::memcpy(locked_pixels + y * locked_pitch, &pixels_arr[y * width * 4], width * 4);
+    }
+
+    SDL_UnlockTexture(texture);
+    locked_pixels = nullptr;
+    dirty = false;
+}
+
+/* Render texture, uploading the local pixel buffer only if it changed */
 void Texture::render_texture() {
     assert(texture);
-    SDL_UpdateTexture(texture, nullptr, pixels_arr.data(), width * 4);
+    if (dirty) {
+        SDL_UpdateTexture(texture, nullptr, pixels_arr.data(), width * 4);
+        dirty = false;
+    }
 
     assert(renderer);
     SDL_RenderCopy(renderer, texture, nullptr, &boundaries);
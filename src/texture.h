@@ -11,8 +11,13 @@ public:
     ~Texture();
 
     void update_texture(uint16_t idx, uint8_t r, uint8_t g, uint8_t b);
+    uint8_t *get_pixels();
     void render_texture();
 
+    // Zero-copy update, straight into the streaming texture memory
+    uint8_t *lock_pixels();
+    void unlock_pixels();
+
 private:
     uint16_t width, height;
 
@@ -20,6 +25,10 @@ private:
     SDL_Rect boundaries;
     SDL_Texture *texture;
     std::vector<uint8_t> pixels_arr;
+    bool dirty;                 // 'pixels_arr' changed since the last upload
+
+    uint8_t *locked_pixels;
+    int locked_pitch;
 };
 
 #endif
@@ -0,0 +1,28 @@
+#include "triple_buffer.h"
+
+/* Constructor */
+TripleBuffer::TripleBuffer(size_t size, uint8_t fill) :
+    back_idx(0), front_idx(1), middle(2)
+{
+    for (auto &buffer : buffers) buffer.assign(size, fill);
+}
+
+/* Destructor */
+TripleBuffer::~TripleBuffer() {}
+
+uint8_t *TripleBuffer::back() { return buffers[back_idx].data(); }
+
+/* Swaps the filled back buffer with the middle one */
+void TripleBuffer::publish() {
+    back_idx = middle.exchange(back_idx | FRESH, std::memory_order_acq_rel) & 0x03;
+}
+
+/* Swaps the front buffer with the middle one if a new buffer was published
+ * since the last call. Returns whether it did */
+bool TripleBuffer::update() {
+    if (!(middle.load(std::memory_order_acquire) & FRESH)) return false;
+    front_idx = middle.exchange(front_idx, std::memory_order_acq_rel) & 0x03;
+    return true;
+}
+
+const uint8_t *TripleBuffer::front() { return buffers[front_idx].data(); }
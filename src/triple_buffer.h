@@ -0,0 +1,35 @@
+#ifndef TRIPLE_BUFFER_H_
+#define TRIPLE_BUFFER_H_
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <inttypes.h>
+
+/* Lock-free triple buffer between one producer and one consumer thread. The
+ * producer fills the back buffer and publishes it, the consumer picks up the
+ * most recently published one. Neither side ever waits for the other, buffers
+ * the consumer does not pick up in time are overwritten */
+class TripleBuffer {
+public:
+    TripleBuffer(size_t size, uint8_t fill = 0x00);
+    ~TripleBuffer();
+
+    // Producer side
+    uint8_t *back();
+    void publish();
+
+    // Consumer side, 'front()' is the buffer picked up by the last 'update()'
+    bool update();
+    const uint8_t *front();
+
+private:
+    static const uint8_t FRESH = 0x04;      // Published, not picked up yet
+
+    std::vector<uint8_t> buffers[3];
+    uint8_t back_idx;                       // Owned by the producer
+    uint8_t front_idx;                      // Owned by the consumer
+    std::atomic<uint8_t> middle;            // Buffer in between, plus 'FRESH'
+};
+
+#endif
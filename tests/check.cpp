@@ -0,0 +1,422 @@
+/* Regression checks for the emulation core, run with 'make check'. Every
+ * equivalence check compares two machines running the same ROM that have to
+ * stay identical: machine state through save state blobs and video output
+ * through the indexed frames. They run on a small NROM image built here and
+ * on any ROM files given on the command line */
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "headless.h"
+#include "save_state.h"
+
+#define NUM_FRAMES      300
+#define FRAMESKIP       3
+#define RUNAHEAD        2
+#define SAVE_FRAME      50
+#define LOAD_FRAMES     50
+
+/*=============================================================================
+ * SYNTHETIC ROM - one 16 kB PRG bank at $C000 (mirrored at $8000) and 8 kB of
+ * CHR. The program draws a background and 8 sprites, scrolls in NMI, copies
+ * OAM with DMA, reads the controller, polls sprite 0 for a split scroll in
+ * the middle of the frame, idles in busy loops and writes to cartridge space
+ *===========================================================================*/
+#define SYNTHETIC_NMI   0xC088
+#define SYNTHETIC_RESET 0xC000
+#define SYNTHETIC_IRQ   0xC0C1
+
+static const uint8_t synthetic_program[] = {
+    // reset ($C000)
+    0x78,                   // SEI
+    0xD8,                   // CLD
+    0xA2, 0xFF,             // LDX #$FF
+    0x9A,                   // TXS
+    0xE8,                   // INX
+    0x8E, 0x00, 0x20,       // STX $2000
+    0x8E, 0x01, 0x20,       // STX $2001
+    // vblank1 ($C00C)
+    0x2C, 0x02, 0x20,       // BIT $2002
+    0x10, 0xFB,             // BPL vblank1
+    0x8A,                   // TXA
+    // clear ($C012)
+    0x95, 0x00,             // STA $00,X
+    0x9D, 0x00, 0x02,       // STA $0200,X
+    0xE8,                   // INX
+    0xD0, 0xF8,             // BNE clear
+    // vblank2 ($C01A)
+    0x2C, 0x02, 0x20,       // BIT $2002
+    0x10, 0xFB,             // BPL vblank2
+    0xA9, 0x3F,             // LDA #$3F
+    0x8D, 0x06, 0x20,       // STA $2006
+    0x8E, 0x06, 0x20,       // STX $2006
+    // pal ($C027)
+    0x8A,                   // TXA
+    0x8D, 0x07, 0x20,       // STA $2007
+    0xE8,                   // INX
+    0xE0, 0x20,             // CPX #$20
+    0xD0, 0xF7,             // BNE pal
+    0xA9, 0x20,             // LDA #$20
+    0x8D, 0x06, 0x20,       // STA $2006
+    0xA9, 0x00,             // LDA #$00
+    0x8D, 0x06, 0x20,       // STA $2006
+    0xA0, 0x04,             // LDY #$04
+    0xA2, 0x00,             // LDX #$00
+    // fill ($C03E)
+    0x8A,                   // TXA
+    0x29, 0x03,             // AND #$03
+    0x8D, 0x07, 0x20,       // STA $2007
+    0xE8,                   // INX
+    0xD0, 0xF7,             // BNE fill
+    0x88,                   // DEY
+    0xD0, 0xF4,             // BNE fill
+    // spr ($C04A)
+    0xBD, 0xC2, 0xC0,       // LDA sprites,X
+    0x9D, 0x00, 0x02,       // STA $0200,X
+    0xE8,                   // INX
+    0xE0, 0x20,             // CPX #$20
+    0xD0, 0xF5,             // BNE spr
+    0xA9, 0x80,             // LDA #$80
+    0x8D, 0x00, 0x20,       // STA $2000
+    0xA9, 0x1E,             // LDA #$1E
+    0x8D, 0x01, 0x20,       // STA $2001
+    // main ($C05F)
+    0xA5, 0x11,             // LDA frame
+    // wait_nmi ($C061)
+    0xC5, 0x11,             // CMP frame
+    0xF0, 0xFC,             // BEQ wait_nmi
+    // s0clear ($C065)
+    0x2C, 0x02, 0x20,       // BIT $2002
+    0x70, 0xFB,             // BVS s0clear
+    // s0set ($C06A)
+    0x2C, 0x02, 0x20,       // BIT $2002
+    0x50, 0xFB,             // BVC s0set
+    0xA5, 0x11,             // LDA frame
+    0x0A,                   // ASL A
+    0x8D, 0x05, 0x20,       // STA $2005
+    0x8D, 0x05, 0x20,       // STA $2005
+    0xA2, 0x40,             // LDX #$40
+    // delay ($C07A)
+    0xCA,                   // DEX
+    0xD0, 0xFD,             // BNE delay
+    0xE6, 0x10,             // INC work
+    0xAD, 0x10, 0x00,       // LDA $0010
+    0x8D, 0x00, 0x60,       // STA $6000
+    0x4C, 0x5F, 0xC0,       // JMP main
+    // nmi ($C088)
+    0x48,                   // PHA
+    0x8A,                   // TXA
+    0x48,                   // PHA
+    0xA9, 0x02,             // LDA #$02
+    0x8D, 0x14, 0x40,       // STA $4014
+    0xA5, 0x11,             // LDA frame
+    0x8D, 0x05, 0x20,       // STA $2005
+    0xA5, 0x12,             // LDA buttons
+    0x8D, 0x05, 0x20,       // STA $2005
+    0xA2, 0x04,             // LDX #$04
+    // move ($C09C)
+    0xFE, 0x03, 0x02,       // INC $0203,X
+    0xE8,                   // INX
+    0xE8,                   // INX
+    0xE8,                   // INX
+    0xE8,                   // INX
+    0xE0, 0x20,             // CPX #$20
+    0xD0, 0xF5,             // BNE move
+    0xA9, 0x01,             // LDA #$01
+    0x8D, 0x16, 0x40,       // STA $4016
+    0xA9, 0x00,             // LDA #$00
+    0x8D, 0x16, 0x40,       // STA $4016
+    0xA2, 0x08,             // LDX #$08
+    // read ($C0B3)
+    0xAD, 0x16, 0x40,       // LDA $4016
+    0x4A,                   // LSR A
+    0x26, 0x12,             // ROL buttons
+    0xCA,                   // DEX
+    0xD0, 0xF7,             // BNE read
+    0xE6, 0x11,             // INC frame
+    0x68,                   // PLA
+    0xAA,                   // TAX
+    0x68,                   // PLA
+    // irq ($C0C1)
+    0x40,                   // RTI
+    // sprites ($C0C2)
+    0x64, 0x01, 0x00, 0x78, // .byte 100, 1, $00, 120
+    0x14, 0x02, 0x01, 0x0A, // .byte 20, 2, $01, 10
+    0x28, 0x03, 0x42, 0x1E, // .byte 40, 3, $42, 30
+    0x3C, 0x01, 0x83, 0x32, // .byte 60, 1, $83, 50
+    0x50, 0x02, 0x20, 0x46, // .byte 80, 2, $20, 70
+    0x78, 0x03, 0x01, 0x5A, // .byte 120, 3, $01, 90
+    0x8C, 0x01, 0x02, 0x6E, // .byte 140, 1, $02, 110
+    0xA0, 0x02, 0xC3, 0x82, // .byte 160, 2, $C3, 130
+};
+
+/* Writes the synthetic ROM to a new temporary file, returns its name or an
+ * empty string on failure */
+static std::string write_synthetic_rom() {
+    std::vector<uint8_t> rom = { 'N', 'E', 'S', 0x1A, 1, 1, 0x01, 0x00,
+                                 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    // PRG, vectors at the end of the bank
+    std::vector<uint8_t> prg(_16_KB, 0xEA);
+    std::memcpy(prg.data(), synthetic_program, sizeof(synthetic_program));
+    uint16_t vectors[3] = { SYNTHETIC_NMI, SYNTHETIC_RESET, SYNTHETIC_IRQ };
+    for (int i = 0; i < 3; i++) {
+        prg[0x3FFA + 2 * i] = vectors[i] & 0x00FF;
+        prg[0x3FFB + 2 * i] = vectors[i] >> 8;
+    }
+    rom.insert(rom.end(), prg.begin(), prg.end());
+
+    // CHR, every row of every tile has opaque pixels so that sprite 0 hits
+    for (uint32_t tile = 0; tile < 512; tile++) {
+        for (uint8_t row = 0; row < 8; row++)
+            rom.push_back((uint8_t)((0x5A << (row & 1)) | ((tile & 1) ? 0x81 : 0x00)));
+        for (uint8_t row = 0; row < 8; row++)
+            rom.push_back((uint8_t)((tile & 2) ? (0xF0 >> (row & 3)) : (0x0F << (row & 3))));
+    }
+
+    char name[] = "/tmp/nes_check_XXXXXX";
+    int fd = mkstemp(name);
+    if (fd < 0) return std::string();
+    bool written = write(fd, rom.data(), rom.size()) == (ssize_t)rom.size();
+    close(fd);
+    if (!written) { std::remove(name); return std::string(); }
+    return name;
+}
+
+/*=============================================================================
+ * HELPERS
+ *===========================================================================*/
+/* Save state blob of 'nes'. Whether sprite 0 was drawn is only tracked for
+ * frames with video output, so it is cleared when 'output_only' is set */
+static std::vector<uint8_t> state_of(Headless &nes, Cartridge &cartridge,
+                                     bool output_only = false) {
+    std::vector<uint8_t> blob;
+    nes.save_state(blob);
+    if (!output_only) return blob;
+
+    Bus::State state;
+    if (!SaveState::read(blob, cartridge, state)) return std::vector<uint8_t>();
+    state.ppu.sprite_zero_rendered = false;
+    SaveState::write(state, cartridge, blob);
+    return blob;
+}
+
+static bool same_frame(Headless &a, Headless &b) {
+    return memcmp(a.get_indexed_frame(), b.get_indexed_frame(),
+                  NES_WINDOW_WIDTH * NES_WINDOW_HEIGHT) == 0;
+}
+
+static void copy_frame(Headless &nes, std::vector<uint8_t> &frame) {
+    const uint8_t *indexed = nes.get_indexed_frame();
+    frame.assign(indexed, indexed + NES_WINDOW_WIDTH * NES_WINDOW_HEIGHT);
+}
+
+static bool fail(const std::string &check, uint32_t frame, const char *what) {
+    std::cout << "> " << check << ": " << what << " differs in frame " << frame << "\n";
+    return false;
+}
+
+/*=============================================================================
+ * CHECKS
+ *===========================================================================*/
+/* The scanline renderer matches the dot renderer */
+static bool check_renderers(const char *nes_file, Cartridge &cartridge) {
+    Headless dot(nes_file, cpu6502::INTERPRETER, ppu2C02::DOT);
+    Headless scanline(nes_file, cpu6502::INTERPRETER, ppu2C02::SCANLINE);
+
+    for (uint32_t frame = 1; frame <= NUM_FRAMES; frame++) {
+        dot.run_frame();
+        scanline.run_frame();
+        if (!same_frame(dot, scanline)) return fail("Renderers", frame, "video output");
+        if (state_of(dot, cartridge) != state_of(scanline, cartridge))
+            return fail("Renderers", frame, "state");
+    }
+    return true;
+}
+
+/* Frames without video output leave the machine as it would be with it */
+static bool check_frameskip(const char *nes_file, Cartridge &cartridge) {
+    Headless reference(nes_file);
+    Headless skipping(nes_file);
+    skipping.set_frameskip(FRAMESKIP);
+
+    for (uint32_t frame = 1; frame <= NUM_FRAMES; frame++) {
+        reference.run_frame();
+        skipping.run_frame();
+        if ((frame - 1) % FRAMESKIP == 0 && !same_frame(reference, skipping))
+            return fail("Frameskip", frame, "video output");
+        if (state_of(reference, cartridge, true) != state_of(skipping, cartridge, true))
+            return fail("Frameskip", frame, "state");
+    }
+    return true;
+}
+
+/* Run-ahead shows the frames of 'RUNAHEAD' frames later and rolls the machine
+ * back completely. Without any input, nothing changes the frames ahead */
+static bool check_runahead(const char *nes_file, Cartridge &cartridge) {
+    Headless reference(nes_file);
+    Headless ahead(nes_file);
+    ahead.set_runahead(RUNAHEAD);
+
+    std::vector<std::vector<uint8_t>> frames(NUM_FRAMES + RUNAHEAD + 1);
+    std::vector<std::vector<uint8_t>> ahead_frames(NUM_FRAMES + 1);
+    for (uint32_t frame = 1; frame <= NUM_FRAMES + RUNAHEAD; frame++) {
+        reference.run_frame();
+        copy_frame(reference, frames[frame]);
+        if (frame > NUM_FRAMES) continue;
+
+        ahead.run_frame();
+        copy_frame(ahead, ahead_frames[frame]);
+        if (state_of(reference, cartridge, true) != state_of(ahead, cartridge, true))
+            return fail("Run-ahead", frame, "state");
+    }
+
+    for (uint32_t frame = 1; frame <= NUM_FRAMES; frame++) {
+        if (ahead_frames[frame] != frames[frame + RUNAHEAD])
+            return fail("Run-ahead", frame, "video output");
+    }
+    return true;
+}
+
+/* A state saved in the middle of a run and loaded into a fresh machine goes
+ * on exactly like the original machine */
+static bool check_save_state(const char *nes_file, Cartridge &cartridge) {
+    Headless original(nes_file);
+    for (uint32_t frame = 1; frame <= SAVE_FRAME; frame++) original.run_frame();
+
+    std::vector<uint8_t> blob;
+    original.save_state(blob);
+    Headless restored(nes_file);
+    if (!restored.load_state(blob)) {
+        std::cout << "> Save state: state saved in frame " << SAVE_FRAME << " does not load\n";
+        return false;
+    }
+
+    for (uint32_t frame = SAVE_FRAME + 1; frame <= SAVE_FRAME + LOAD_FRAMES; frame++) {
+        original.run_frame();
+        restored.run_frame();
+    }
+    if (!same_frame(original, restored))
+        return fail("Save state", SAVE_FRAME + LOAD_FRAMES, "video output");
+    if (state_of(original, cartridge) != state_of(restored, cartridge))
+        return fail("Save state", SAVE_FRAME + LOAD_FRAMES, "state");
+    return true;
+}
+
+/* The block backend, fused pairs included, matches the interpreter clocked
+ * tick by tick. Among other things, writes to cartridge space have to reach
+ * the mapper on the same tick, see 'Headless::differential()' */
+static bool check_blocks(const char *nes_file) {
+    return Headless::differential(nes_file, NUM_FRAMES, ppu2C02::DOT) &&
+           Headless::differential(nes_file, NUM_FRAMES, ppu2C02::SCANLINE);
+}
+
+/*=============================================================================
+ * SAVE STATE REJECTION - malformed blobs fail to load
+ *===========================================================================*/
+#define BLOB_VERSION    4       // Offsets in the blob header
+#define BLOB_CHECKSUM   6
+
+static bool rejected(const char *nes_file, const std::vector<uint8_t> &blob,
+                     const char *what) {
+    Headless nes(nes_file);
+    if (!nes.load_state(blob)) return true;
+    std::cout << "> Save state: blob with " << what << " loads\n";
+    return false;
+}
+
+/* Blob of the state of 'nes' after 'change' is applied to it */
+template <typename Change>
+static std::vector<uint8_t> changed_blob(Headless &nes, Cartridge &cartridge,
+                                         Change change) {
+    std::vector<uint8_t> blob;
+    Bus::State state;
+    nes.save_state(blob);
+    SaveState::read(blob, cartridge, state);
+    change(state);
+    SaveState::write(state, cartridge, blob);
+    return blob;
+}
+
+static bool check_malformed_states(const char *nes_file, Cartridge &cartridge) {
+    Headless nes(nes_file);
+    for (uint32_t frame = 1; frame <= SAVE_FRAME; frame++) nes.run_frame();
+
+    std::vector<uint8_t> valid;
+    nes.save_state(valid);
+    if (!Headless(nes_file).load_state(valid)) {
+        std::cout << "> Save state: valid blob does not load\n";
+        return false;
+    }
+
+    std::vector<uint8_t> blob = valid;
+    blob[0] ^= 0xFF;
+    if (!rejected(nes_file, blob, "bad magic")) return false;
+
+    blob = valid;
+    blob[BLOB_VERSION]++;
+    if (!rejected(nes_file, blob, "another version")) return false;
+
+    blob = valid;
+    blob[BLOB_CHECKSUM] ^= 0x01;
+    if (!rejected(nes_file, blob, "another ROM checksum")) return false;
+
+    for (size_t size : { (size_t)0, valid.size() / 2, valid.size() - 1 }) {
+        blob.assign(valid.begin(), valid.begin() + size);
+        if (!rejected(nes_file, blob, "missing bytes")) return false;
+    }
+
+    blob = valid;
+    blob.push_back(0x00);
+    if (!rejected(nes_file, blob, "trailing bytes")) return false;
+
+    // Values the PPU uses as indices
+    blob = changed_blob(nes, cartridge, [](Bus::State &state) { state.ppu.sprite_count = 9; });
+    if (!rejected(nes_file, blob, "sprite_count 9")) return false;
+    blob = changed_blob(nes, cartridge, [](Bus::State &state) { state.ppu.fine_x = 8; });
+    if (!rejected(nes_file, blob, "fine_x 8")) return false;
+    blob = changed_blob(nes, cartridge, [](Bus::State &state) { state.ppu.scan_line = -2; });
+    if (!rejected(nes_file, blob, "scan_line -2")) return false;
+    blob = changed_blob(nes, cartridge, [](Bus::State &state) { state.ppu.scan_line = 261; });
+    if (!rejected(nes_file, blob, "scan_line 261")) return false;
+    blob = changed_blob(nes, cartridge, [](Bus::State &state) { state.ppu.cycle = -1; });
+    if (!rejected(nes_file, blob, "cycle -1")) return false;
+    blob = changed_blob(nes, cartridge, [](Bus::State &state) { state.ppu.cycle = 341; });
+    if (!rejected(nes_file, blob, "cycle 341")) return false;
+    return true;
+}
+
+/*=============================================================================
+ * MAIN
+ *===========================================================================*/
+static bool check_rom(const char *nes_file, const char *name) {
+    Cartridge cartridge(nes_file);
+    bool matching = check_renderers(nes_file, cartridge) &&
+                    check_frameskip(nes_file, cartridge) &&
+                    check_runahead(nes_file, cartridge) &&
+                    check_save_state(nes_file, cartridge) &&
+                    check_blocks(nes_file);
+    std::cout << "> " << (matching ? "PASS" : "FAIL") << " " << name << "\n";
+    return matching;
+}
+
+int main(int argc, char *argv[]) {
+    std::string synthetic_rom = write_synthetic_rom();
+    if (synthetic_rom.empty()) {
+        std::cout << "> Could not write the synthetic ROM\n";
+        return EXIT_FAILURE;
+    }
+
+    Cartridge cartridge(synthetic_rom.c_str());
+    bool malformed = check_malformed_states(synthetic_rom.c_str(), cartridge);
+    std::cout << "> " << (malformed ? "PASS" : "FAIL") << " malformed save states\n";
+
+    bool passed = check_rom(synthetic_rom.c_str(), "synthetic ROM") && malformed;
+    std::remove(synthetic_rom.c_str());
+
+    for (int i = 1; i < argc; i++) passed = check_rom(argv[i], argv[i]) && passed;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}